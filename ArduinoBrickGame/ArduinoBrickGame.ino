@@ -8,10 +8,17 @@
 #include <Adafruit_ST7735.h> // https://github.com/adafruit/Adafruit-ST7735-Library library for ST7735
 #include <RF24.h>			 // https://github.com/nRF24/RF24 - RF24 by TMRh20
 #include <avr/eeprom.h>
+#include "Battery.h"
 #include "ButtonEvent.h"
+#include "Games.h"
+#include "Haptics.h"
 #include "MainMenu.h"
 #include "Pong.h"
+#include "Power.h"
+#include "RadioLink.h"
 #include "Settings.h"
+#include "Sound.h"
+#include "Tasks.h"
 
 /*
 	Display has 128x160 resolution.
@@ -42,6 +49,7 @@
 				- SCK -> D13
 				- MOSI -> D11
 				- MISO -> D12
+				- IRQ -> D0 (see RadioLink.h)
 
 	If uploading first time / using new arduino, go to settings and set the console ID.
 */
@@ -63,47 +71,51 @@ Adafruit_ST7735 display = Adafruit_ST7735(DISPLAY_CS, DISPLAY_DC, DISPLAY_RST);
 RF24 radio(nRF24_CE, nRF24_CSN);
 
 /*
-	This function should be called continuously in the loop without any parameters.
-	If vibration is required, pass a parameter of how long it should vibrate.
+	Timer0 compare A interrupt, fires about every 1 ms (once per Timer0 overflow,
+	enabled in button.begin()). Keep it short, it runs in the middle of everything.
+*/
+ISR(TIMER0_COMPA_vect)
+{
+	button.scan();
+	battery.tick();
+	sound.tick();
+	haptics.tick();
+}
 
-	So there must be a call to any loop that might take a long time, or
-	vibrations might be stuck ON.
+/*
+	ADC conversion complete, only the battery monitor starts conversions.
+*/
+ISR(ADC_vect)
+{
+	battery.conversion();
+}
 
-	I'm assuming there will be no instance when we want vibrations to be longer than 2 seconds.
-	If passed with vibr > 2000 it means "shut it off"
+/*
+	Pin change interrupt of D0-D7, only the radio IRQ pin is enabled.
 */
-void vibrate(unsigned long newDuration = __LONG_MAX__, byte newPwm = 255)
+ISR(PCINT2_vect)
 {
-	static unsigned long startedAt = 0;
-	static unsigned long duration = 0;
+	radioLink.interrupt();
+}
 
-	// if passed with parameter and vibrations are not disabled
-	if (newDuration != __LONG_MAX__ && newDuration <= 2000 && SETTINGS.vibrations)
-	{
-		duration = newDuration;
-		analogWrite(VIBR, newPwm);
-		startedAt = millis();
-		return;
-	}
-	else if (newDuration != __LONG_MAX__ && newDuration > 2000)
-	{
-		duration = 0;
-		startedAt = 0;
-	}
+/*
+	Background tasks, see Tasks.h.
+*/
 
-	// if without, check if vibration should be turned off
-	if (millis() - startedAt > duration)
-	{
-		digitalWrite(VIBR, 0);
-	}
+// reads what came over the radio into RAM as soon as the bus is free, on any screen
+void radioTask()
+{
+	radioLink.service();
 }
 
-void toneHelper(unsigned int freq, unsigned int duration)
+// beeps once when the battery gets low
+void batteryTask()
 {
-	if (SETTINGS.sound)
-		tone(BUZZER, freq, duration);
-	else
-		noTone(BUZZER);
+	static bool warned = false;
+
+	if (battery.low() && !warned)
+		sound.play(soundBatteryLow);
+	warned = battery.low();
 }
 
 void setup(void)
@@ -116,6 +128,8 @@ void setup(void)
 	// Serial.begin(9600);
 	pinMode(BUZZER, OUTPUT);
 	pinMode(VIBR, OUTPUT);
+	button.begin();
+	battery.begin();
 
 	display.initR(INITR_GREENTAB);
 	display.fillScreen(0);
@@ -134,30 +148,32 @@ void setup(void)
 	// radio.setPALevel( RF24_PA_LOW ); // RF24_PA_MAX is default.
 	radio.setPALevel(RF24_PA_HIGH);
 
+	// packets have different lengths, see NetPacket.h
+	radio.enableDynamicPayloads();
+
 	// set the TX address of the RX node into the TX pipe
 	radio.openWritingPipe(radioAddress[SETTINGS.id]); // always uses pipe 0
 
 	// set the RX address of the TX node into a RX pipe
 	radio.openReadingPipe(1, radioAddress[!SETTINGS.id]); // using pipe 1
 
-	radio.powerDown();
+	// received packets are signaled on the IRQ pin
+	radioLink.begin();
+
+	power.radioOff();
+
+	tasks.add(radioTask, 0, TASK_PRIORITY_HIGH);
+	tasks.add(batteryTask, 1000, TASK_PRIORITY_LOW);
 }
 
 void loop()
 {
-	radio.powerDown();
-	vibrate(10000);
-	digitalWrite(VIBR, 0);
-	noTone(BUZZER);
-	delay(100);
-
-	int returnedFromMenu = mainMenu();
-
-	if (returnedFromMenu == 0)
-	{
-		display.fillScreen(COLOR_BLACK);
-		Pong pong;
-		if (pong.pong_menu())
-			pong.pong_play();
-	}
+	power.radioOff();
+	haptics.stop();
+	sound.stop();
+	tasks.sleep(100);
+
+	int game = mainMenu();
+	if (game >= 0)
+		playGame(game);
 }
@@ -0,0 +1,370 @@
+#pragma once
+#include <Adafruit_ST7735.h> // https://github.com/adafruit/Adafruit-ST7735-Library library for ST7735
+#include "ButtonEvent.h"
+#include "Renderer.h"
+
+extern Adafruit_ST7735 display;
+
+/*
+	Band renderer for the play field.
+
+	Every frame the game lists what is on the field (rectangles, one circle,
+	one line of text), all white on black. The list is compared with the one
+	of the last frame, and the screen is split into bands of BAND_ROWS rows.
+	In every band the parts that changed are joined into at most BAND_SPANS
+	boxes, and each box is sent with a single address window: its rows are
+	composed one after another into a line buffer (one bit per pixel) from
+	everything on the list, and pushed as runs of one color.
+
+	Compared to Renderer.h nothing has to be repaired after the ball passed
+	over it, and the score is drawn from a small font in PROGMEM instead of
+	a pixel at a time by Adafruit_GFX.
+
+	With RENDER_BANDS 0 the game draws with Renderer.h instead, for comparing
+	the two in the simulator:
+		make CXXFLAGS="-O2 -DRENDER_BANDS=0"
+
+	Usage:
+		bandRenderer.begin(); // screen was cleared
+		...
+		bandRenderer.beginFrame();
+		bandRenderer.rect(0, 0, 1, 160);
+		bandRenderer.circle(ballX, ballY, 2);
+		bandRenderer.text("You 1 - 0 other", 22, 75);
+		bandRenderer.endFrame(); // sends what changed
+*/
+#ifndef RENDER_BANDS
+#define RENDER_BANDS 1
+#endif
+
+#define BAND_ROWS 8
+#define BAND_COUNT (160 / BAND_ROWS)
+#define BAND_SPANS 2	   // boxes sent per band
+#define BAND_MERGE_GAP 6   // px, a new address window costs about as much as sending 6 pixels
+#define BAND_SHAPES 6	   // things on the field
+#define BAND_TEXT_MAX 20   // characters of the text
+#define BAND_MAX_RADIUS 3  // circle mask rows are single bytes
+#define BAND_COLOR COLOR_WHITE
+
+#define BAND_RECT 0
+#define BAND_CIRCLE 1
+#define BAND_TEXT 2
+
+/*
+	Characters of the score from the Adafruit_GFX 5x7 font,
+	5 columns each, bit 0 is the top row.
+*/
+#define BAND_FONT_CHARS " -0123456789Yehortu"
+const byte bandFont[][5] PROGMEM = {
+	{0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+	{0x08, 0x08, 0x08, 0x08, 0x08}, // '-'
+	{0x3E, 0x51, 0x49, 0x45, 0x3E}, // '0'
+	{0x00, 0x42, 0x7F, 0x40, 0x00}, // '1'
+	{0x72, 0x49, 0x49, 0x49, 0x46}, // '2'
+	{0x21, 0x41, 0x49, 0x4D, 0x33}, // '3'
+	{0x18, 0x14, 0x12, 0x7F, 0x10}, // '4'
+	{0x27, 0x45, 0x45, 0x45, 0x39}, // '5'
+	{0x3C, 0x4A, 0x49, 0x49, 0x31}, // '6'
+	{0x41, 0x21, 0x11, 0x09, 0x07}, // '7'
+	{0x36, 0x49, 0x49, 0x49, 0x36}, // '8'
+	{0x46, 0x49, 0x49, 0x29, 0x1E}, // '9'
+	{0x07, 0x08, 0x70, 0x08, 0x07}, // 'Y'
+	{0x38, 0x54, 0x54, 0x54, 0x18}, // 'e'
+	{0x7F, 0x08, 0x04, 0x04, 0x78}, // 'h'
+	{0x38, 0x44, 0x44, 0x44, 0x38}, // 'o'
+	{0x7C, 0x08, 0x04, 0x04, 0x08}, // 'r'
+	{0x04, 0x3F, 0x44, 0x40, 0x20}, // 't'
+	{0x3C, 0x40, 0x40, 0x20, 0x7C}, // 'u'
+};
+
+#if RENDER_BANDS
+
+class BandRenderer
+{
+private:
+	struct Shape
+	{
+		byte kind;
+		int16_t x, y;
+		byte w, h; // radius of a circle, characters of the text
+	};
+
+	// this frame's list and the one on the screen
+	Shape shapes[BAND_SHAPES], drawnShapes[BAND_SHAPES];
+	byte shapeCount = 0, drawnCount = 0;
+	char chars[BAND_TEXT_MAX + 1], drawnChars[BAND_TEXT_MAX + 1];
+
+	// what has to be sent in each band, inclusive screen coordinates
+	struct Span
+	{
+		byte x0, x1, y0, y1;
+	} spans[BAND_COUNT][BAND_SPANS];
+	byte spanCount[BAND_COUNT];
+
+	byte line[128 / 8]; // one row, bit 0 of byte 0 is x = 0
+	byte circleRows[BAND_MAX_RADIUS * 2 + 1];
+	byte circleRadius = 0;
+
+	void add(byte kind, int16_t x, int16_t y, byte w, byte h)
+	{
+		if (shapeCount < BAND_SHAPES)
+			shapes[shapeCount++] = {kind, x, y, w, h};
+	}
+
+	static void bounds(const Shape &s, int16_t &x0, int16_t &y0, int16_t &x1, int16_t &y1)
+	{
+		switch (s.kind)
+		{
+		case BAND_CIRCLE:
+			x0 = s.x - s.w;
+			y0 = s.y - s.w;
+			x1 = s.x + s.w;
+			y1 = s.y + s.w;
+			break;
+		case BAND_TEXT:
+			x0 = s.x;
+			y0 = s.y;
+			x1 = s.x + s.w * 6 - 1;
+			y1 = s.y + 7;
+			break;
+		default:
+			x0 = s.x;
+			y0 = s.y;
+			x1 = s.x + s.w - 1;
+			y1 = s.y + s.h - 1;
+		}
+	}
+
+	static bool joins(const Span &s, int16_t x0, int16_t x1)
+	{
+		return x0 <= s.x1 + BAND_MERGE_GAP && x1 >= s.x0 - BAND_MERGE_GAP;
+	}
+
+	static void join(Span &s, byte x0, byte y0, byte x1, byte y1)
+	{
+		s.x0 = min(s.x0, x0);
+		s.x1 = max(s.x1, x1);
+		s.y0 = min(s.y0, y0);
+		s.y1 = max(s.y1, y1);
+	}
+
+	/*
+		Marks the area of a shape as changed, in every band it touches.
+	*/
+	void invalidate(const Shape &shape)
+	{
+		int16_t x0, y0, x1, y1;
+		bounds(shape, x0, y0, x1, y1);
+
+		x0 = max(x0, 0);
+		y0 = max(y0, 0);
+		x1 = min(x1, (int16_t)display.width() - 1);
+		y1 = min(y1, (int16_t)display.height() - 1);
+		if (x0 > x1 || y0 > y1)
+			return;
+
+		for (byte band = y0 / BAND_ROWS; band <= y1 / BAND_ROWS; band++)
+		{
+			byte top = max(y0, (int16_t)(band * BAND_ROWS));
+			byte bottom = min(y1, (int16_t)(band * BAND_ROWS + BAND_ROWS - 1));
+			Span *s = spans[band];
+			byte &count = spanCount[band];
+
+			byte i = 0;
+			while (i < count && !joins(s[i], x0, x1))
+				i++;
+
+			if (i == count && count < BAND_SPANS)
+			{
+				s[count++] = {(byte)x0, (byte)x1, top, bottom};
+				continue;
+			}
+
+			// no free span left, the last one grows
+			if (i == count)
+				i = count - 1;
+			join(s[i], x0, top, x1, bottom);
+
+			// it can reach the other one now
+			if (count == 2 && joins(s[1 - i], s[i].x0, s[i].x1))
+			{
+				join(s[0], s[1].x0, s[1].y0, s[1].x1, s[1].y1);
+				count = 1;
+			}
+		}
+	}
+
+	static bool same(const Shape &a, const Shape &b)
+	{
+		return a.kind == b.kind && a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+	}
+
+	// sets pixels x0-x1 of the line, clipped to the span sent
+	void fill(int16_t x0, int16_t x1, const Span &span)
+	{
+		x0 = max(x0, (int16_t)span.x0);
+		x1 = min(x1, (int16_t)span.x1);
+
+		for (int16_t x = x0; x <= x1; x++)
+			line[x >> 3] |= 1 << (x & 7);
+	}
+
+	/*
+		Draws everything on the list that crosses row y into the line.
+	*/
+	void compose(int16_t y, const Span &span)
+	{
+		for (byte x = span.x0 >> 3; x <= span.x1 >> 3; x++)
+			line[x] = 0;
+
+		for (byte i = 0; i < shapeCount; i++)
+		{
+			const Shape &s = shapes[i];
+			int16_t x0, y0, x1, y1;
+			bounds(s, x0, y0, x1, y1);
+			if (y < y0 || y > y1 || x1 < span.x0 || x0 > span.x1)
+				continue;
+
+			if (s.kind == BAND_RECT)
+				fill(x0, x1, span);
+			else if (s.kind == BAND_CIRCLE)
+			{
+				byte bits = circleRows[y - y0];
+				for (byte b = 0; bits; b++, bits >>= 1)
+					if (bits & 1)
+						fill(x0 + b, x0 + b, span);
+			}
+			else if (y - y0 < 7)
+			{
+				for (byte c = 0; c < s.w; c++)
+				{
+					int16_t cx = x0 + c * 6;
+					if (cx + 4 < span.x0 || cx > span.x1)
+						continue;
+
+					const char *found = strchr(BAND_FONT_CHARS, chars[c]);
+					if (!found || !chars[c])
+						continue;
+
+					for (byte col = 0; col < 5; col++)
+						if (pgm_read_byte(&bandFont[found - BAND_FONT_CHARS][col]) & (1 << (y - y0)))
+							fill(cx + col, cx + col, span);
+				}
+			}
+		}
+	}
+
+	/*
+		Sends the span with one address window, row by row as runs of one color.
+	*/
+	void send(const Span &span)
+	{
+		display.setAddrWindow(span.x0, span.y0, span.x1 - span.x0 + 1, span.y1 - span.y0 + 1);
+
+		for (int16_t y = span.y0; y <= span.y1; y++)
+		{
+			compose(y, span);
+
+			byte x = span.x0;
+			while (x <= span.x1)
+			{
+				bool on = line[x >> 3] & (1 << (x & 7));
+				byte length = 0;
+				while (x <= span.x1 && (bool)(line[x >> 3] & (1 << (x & 7))) == on)
+				{
+					x++;
+					length++;
+				}
+				display.writeColor(on ? BAND_COLOR : COLOR_BLACK, length);
+			}
+		}
+	}
+
+public:
+	/*
+		Call after the screen was cleared, nothing is drawn on it.
+	*/
+	void begin()
+	{
+		shapeCount = drawnCount = 0;
+		chars[0] = drawnChars[0] = 0;
+	}
+
+	/*
+		Starts the list of this frame, everything that should stay on the
+		screen has to be listed again.
+	*/
+	void beginFrame()
+	{
+		shapeCount = 0;
+		chars[0] = 0;
+	}
+
+	void rect(int16_t x, int16_t y, byte w, byte h)
+	{
+		add(BAND_RECT, x, y, w, h);
+	}
+
+	/*
+		Circle outline like Adafruit_GFX::drawCircle, only one per frame.
+	*/
+	void circle(int16_t x, int16_t y, byte radius)
+	{
+		if (radius != circleRadius)
+		{
+			Renderer::circleMask(radius, circleRows);
+			circleRadius = radius;
+		}
+		add(BAND_CIRCLE, x, y, radius, 0);
+	}
+
+	/*
+		Text in the 5x7 font, only the characters of BAND_FONT_CHARS,
+		one per frame. Pass x = -1 to center it.
+	*/
+	void text(const char *str, int16_t x, int16_t y)
+	{
+		strncpy(chars, str, BAND_TEXT_MAX);
+		chars[BAND_TEXT_MAX] = 0;
+		byte length = strlen(chars);
+
+		if (x < 0)
+			x = (display.width() - length * 6) / 2;
+		add(BAND_TEXT, x, y, length, 8);
+	}
+
+	/*
+		Sends everything that is different from the last frame.
+	*/
+	void endFrame()
+	{
+		memset(spanCount, 0, sizeof(spanCount));
+
+		for (byte i = 0; i < max(shapeCount, drawnCount); i++)
+		{
+			bool now = i < shapeCount;
+			bool before = i < drawnCount;
+
+			if (now && before && same(shapes[i], drawnShapes[i]) &&
+				(shapes[i].kind != BAND_TEXT || strcmp(chars, drawnChars) == 0))
+				continue;
+
+			if (before)
+				invalidate(drawnShapes[i]);
+			if (now)
+				invalidate(shapes[i]);
+		}
+
+		display.startWrite();
+		for (byte band = 0; band < BAND_COUNT; band++)
+			for (byte i = 0; i < spanCount[band]; i++)
+				send(spans[band][i]);
+		display.endWrite();
+
+		memcpy(drawnShapes, shapes, sizeof(shapes));
+		drawnCount = shapeCount;
+		strcpy(drawnChars, chars);
+	}
+} bandRenderer;
+
+#endif
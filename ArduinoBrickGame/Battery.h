@@ -0,0 +1,156 @@
+#pragma once
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+// all objects defined in main .ino file that will also be used here
+extern const byte BATTERY;
+
+/*
+	Battery monitor.
+
+	The ADC runs in the background: every BATTERY_SAMPLE_TICKS Timer0 ticks
+	(~1 ms each) tick() starts a conversion, and when it is done the ADC
+	interrupt adds the sample to a moving average (exponential, 1 / 2^
+	BATTERY_FILTER_SHIFT of each new sample). Reading the voltage is only
+	a copy of that average, nothing waits for the ADC.
+
+	The battery is on A0 without a divider, measured against the 5 V supply.
+
+	The low state has hysteresis, it is entered under BATTERY_LOW_MV and
+	left only above BATTERY_LOW_MV + BATTERY_HYSTERESIS_MV, so a battery
+	sitting at the threshold doesn't toggle it. Entering it raises an event
+	that lowEvent() returns once.
+
+	Usage:
+		battery.begin(); // in setup(), after button.begin()
+		ISR(ADC_vect) { battery.conversion(); }
+		// and battery.tick() in the Timer0 interrupt
+
+		print(battery.millivolts());
+		if (battery.lowEvent())
+			drawInfoPanel();
+*/
+#define BATTERY_SAMPLE_TICKS 100 // ~0.1 s between samples
+#define BATTERY_FILTER_SHIFT 3	 // average of roughly the last 8 samples
+#define BATTERY_REFERENCE_MV 5000
+#define BATTERY_EMPTY_MV 3500
+#define BATTERY_FULL_MV 4200
+#define BATTERY_LOW_MV 3600
+#define BATTERY_HYSTERESIS_MV 100
+
+// ADC reading (0 - 1023) of a voltage, times 2^BATTERY_FILTER_SHIFT like the average
+#define BATTERY_FILTERED(mv) ((uint16_t)((mv) * 1024UL / BATTERY_REFERENCE_MV) << BATTERY_FILTER_SHIFT)
+
+/*
+	State of charge of a Li-ion cell at rest, it is far from linear in the
+	middle. Linear between the points.
+*/
+const struct
+{
+	uint16_t mv;
+	byte percent;
+} batteryCurve[] PROGMEM = {{3500, 0}, {3600, 8}, {3700, 25}, {3800, 48}, {3900, 65}, {4000, 80}, {4100, 92}, {4200, 100}};
+
+class BatteryMonitor
+{
+private:
+	volatile uint16_t filtered; // average of the ADC readings, times 2^BATTERY_FILTER_SHIFT
+	volatile bool isLow = false;
+	volatile bool lowPending = false;
+	byte ticks = 0;
+
+public:
+	/*
+		Sets the ADC up and takes the first reading, the average starts
+		there. Must be called before interrupts of the ADC can come.
+	*/
+	void begin()
+	{
+		filtered = analogRead(BATTERY) << BATTERY_FILTER_SHIFT;
+		isLow = filtered < BATTERY_FILTERED(BATTERY_LOW_MV);
+		lowPending = isLow;
+
+		// AVcc reference, channel of the battery pin, interrupt when done, 125 kHz ADC clock
+		ADMUX = _BV(REFS0) | ((BATTERY - A0) & 0x07);
+		ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+	}
+
+	/*
+		Call from the Timer0 interrupt, starts a conversion when it is time.
+	*/
+	void tick()
+	{
+		if (++ticks < BATTERY_SAMPLE_TICKS)
+			return;
+
+		ticks = 0;
+		ADCSRA |= _BV(ADSC);
+	}
+
+	/*
+		Call from the ADC interrupt, a conversion is done.
+	*/
+	void conversion()
+	{
+		uint16_t average = filtered - (filtered >> BATTERY_FILTER_SHIFT) + ADC;
+		filtered = average;
+
+		if (!isLow && average < BATTERY_FILTERED(BATTERY_LOW_MV))
+		{
+			isLow = true;
+			lowPending = true;
+		}
+		else if (isLow && average > BATTERY_FILTERED(BATTERY_LOW_MV + BATTERY_HYSTERESIS_MV))
+			isLow = false;
+	}
+
+	uint16_t millivolts() const
+	{
+		noInterrupts();
+		uint16_t average = filtered;
+		interrupts();
+
+		return ((unsigned long)average * BATTERY_REFERENCE_MV >> BATTERY_FILTER_SHIFT) / 1024;
+	}
+
+	// estimated state of charge, 0 - 100
+	byte percent() const
+	{
+		uint16_t mv = millivolts();
+		const byte points = sizeof(batteryCurve) / sizeof(batteryCurve[0]);
+
+		if (mv <= pgm_read_word(&batteryCurve[0].mv))
+			return 0;
+
+		for (byte i = 1; i < points; i++)
+		{
+			uint16_t high = pgm_read_word(&batteryCurve[i].mv);
+			if (mv < high)
+			{
+				uint16_t low = pgm_read_word(&batteryCurve[i - 1].mv);
+				byte from = pgm_read_byte(&batteryCurve[i - 1].percent);
+				byte to = pgm_read_byte(&batteryCurve[i].percent);
+				return from + (unsigned long)(mv - low) * (to - from) / (high - low);
+			}
+		}
+
+		return 100;
+	}
+
+	bool low() const
+	{
+		return isLow;
+	}
+
+	/*
+		True once after the battery got low.
+	*/
+	bool lowEvent()
+	{
+		if (!lowPending)
+			return false;
+
+		lowPending = false;
+		return true;
+	}
+} battery;
@@ -1,17 +1,34 @@
 #pragma once
 /*
-	Button debouncing class I wrote long time ago.
-	To check the button state, need to continuously call the state() function.
-	It returns 0 is button not pressed, 1 if short pressed and let go,
-	2 if button is held down.
+	Buttons of the console.
 
-	There is a struct specific to this project defined after the class.
-	All buttons can be check if you include this file.
+	Buttons are scanned from the timer interrupt (button.scan(), about every
+	1 ms, see ISR in the main .ino file). Both ports are read at once and
+	debounced there, so a press is not missed even if the game loop is busy
+	drawing when it happens.
 
-	For button pins / names check that struct.
+	There are three ways to read them:
+		- state() of each button. It returns 0 is button not pressed,
+		  1 if short pressed and let go, 2 if button is held down.
+		  A short press that is not read within buttonClickTimeout is dropped.
 
-	Usage example:
-		if (button.ok.state() == 1) Serial.println("Button OK pressed");
+			if (button.ok.state() == 1) Serial.println("Button OK pressed");
+
+		- events with the time they happened, from a small queue:
+
+			ButtonEvent e;
+			while (button.read(e))
+				if (e.button == BUTTON_ESC && e.type == BUTTON_PRESS) ...
+
+		- raw() of each button, undebounced, from a snapshot of all of them
+		  taken once per frame with button.sample():
+
+			button.sample();
+			if (button.left.raw()) ...
+
+	Call button.begin() in setup().
+
+	For button pins / names check the s_button struct.
 
 	There are also other function here for ease to include them in all other files.
 */
@@ -28,6 +45,8 @@
 
 #define buttonDebounceDelay 20 // minimum delay between change of signals
 #define buttonHoldTimer 400	   // how long to hold the button before it's considered being hold
+#define buttonClickTimeout 500 // how long a short press waits to be read by state()
+#define buttonEventQueue 8	   // size of the event queue, must be a power of 2
 
 /*
 	Returns a color code for the display.
@@ -59,27 +78,45 @@ unsigned int getColor(int red, int green, int blue)
 	return rgb;
 }
 
+/*
+	Button ids, also bit of the button in the masks below.
+*/
+#define BUTTON_OK 0
+#define BUTTON_ESC 1
+#define BUTTON_MENU 2
+#define BUTTON_UP 3
+#define BUTTON_RIGHT 4
+#define BUTTON_DOWN 5
+#define BUTTON_LEFT 6
+#define BUTTON_COUNT 7
+
+#define BUTTON_PRESS 0
+#define BUTTON_RELEASE 1
+#define BUTTON_HOLD 2 // held for buttonHoldTimer
+
+struct ButtonEvent
+{
+	byte button; // BUTTON_OK...
+	byte type;	 // BUTTON_PRESS...
+	uint16_t time; // lower 16 bits of millis()
+};
+
 class BUTTON
 {
 private:
-	bool buttonLastState;		  // what was last button state
-	bool buttonCurrentState;	  // what is current state
-	bool buttonPressUsed;		  // if button was determined to be pressed, use this to return true only once
-	byte buttonID;				  // holds button id, like A1
-	unsigned long buttonDebounce; // holds time when button changed last time
+	byte buttonID; // holds button id, like A1
+	byte bit;	   // BUTTON_OK...
 
 public:
-	// constructor that sets all variables to default
-	BUTTON(byte buttonID_c)
+	BUTTON(byte buttonID_c, byte bit_c)
 	{
-		pinMode(buttonID_c, INPUT_PULLUP);
-
-		// update all variables
 		buttonID = buttonID_c;
-		buttonDebounce = 0;
-		buttonLastState = HIGH;
-		buttonCurrentState = HIGH;
-		buttonPressUsed = true;
+		bit = bit_c;
+	}
+
+	byte pin() const
+	{
+		return buttonID;
 	}
 
 	/*
@@ -88,63 +125,219 @@ public:
 		- 1 if button pressed and released
 		- 2 - if button is being held down
 	*/
-	int state()
+	int state();
+
+	/*
+		Returns unfiltered state of the button from the last button.sample().
+		True if button is pressed, false otherwise.
+	*/
+	bool raw();
+};
+
+struct s_button
+{
+	BUTTON ok = BUTTON(A1, BUTTON_OK);
+	BUTTON esc = BUTTON(A2, BUTTON_ESC);
+	BUTTON menu = BUTTON(A3, BUTTON_MENU);
+	BUTTON up = BUTTON(A4, BUTTON_UP);
+	BUTTON right = BUTTON(A5, BUTTON_RIGHT);
+	BUTTON down = BUTTON(4, BUTTON_DOWN);
+	BUTTON left = BUTTON(2, BUTTON_LEFT);
+
+	// bit per button, written by scan()
+	volatile byte pressed = 0; // debounced state
+	volatile byte held = 0;	   // pressed for longer than buttonHoldTimer
+	volatile byte clicked = 0; // short press that state() has not returned yet
+
+	/*
+		Sets the pins and starts scanning. Timer0 is already running for millis(),
+		this only enables its compare A interrupt, which fires once per overflow.
+	*/
+	void begin()
 	{
-		// read actual button state
-		buttonCurrentState = digitalRead(buttonID);
+		BUTTON *all[] = {&ok, &esc, &menu, &up, &right, &down, &left};
+		for (byte i = 0; i < BUTTON_COUNT; i++)
+			pinMode(all[i]->pin(), INPUT_PULLUP);
 
-		// check if it changed from last time, if it did take note of the time
-		if (buttonCurrentState != buttonLastState)
-			buttonDebounce = millis();
+		OCR0A = 0x80;
+		TIMSK0 |= _BV(OCIE0A);
+	}
 
-		// update the last state variable
-		buttonLastState = buttonCurrentState;
+	/*
+		Reads both ports and returns a bit per button (BUTTON_OK...), 1 is pressed.
+	*/
+	static byte readPins()
+	{
+		// ok-right are A1-A5 (PC1-PC5), down is D4 (PD4), left is D2 (PD2), pressed is LOW
+		byte pins = (PINC >> 1) & 0x1F;
+		byte portD = PIND;
+		pins |= (portD & _BV(4)) << 1;
+		pins |= (portD & _BV(2)) << 4;
+		return ~pins & 0x7F;
+	}
 
-		// check if button is being held down
-		if (millis() - buttonDebounce > buttonHoldTimer && buttonCurrentState == LOW)
-		{
-			// prevent from setting the "isPressed" and "isHeld" signal simultaneously
-			buttonPressUsed = true;
+	/*
+		Reads all buttons. Called from the timer interrupt only.
 
-			return 2;
-		}
+		All seven buttons are debounced at once with a 2 bit vertical counter:
+		bit i of count0 / count1 is the counter of button i. A button has to read
+		different from its debounced state in 4 samples in a row to change,
+		samples are taken every buttonDebounceDelay / 4 ticks.
+	*/
+	void scan()
+	{
+		if (++sampleTicks < buttonDebounceDelay / 4)
+			return;
+		sampleTicks = 0;
+
+		byte differs = pressed ^ readPins();
+		count0 = ~(count0 & differs);
+		count1 = count0 ^ (count1 & differs);
+		byte changed = differs & count0 & count1; // counter rolled over
+		byte down = pressed ^ changed;
+		pressed = down;
 
-		// now check if button is in its current state for long enough, but trigger only if button is let go
-		else if ((millis() - buttonDebounce) > buttonDebounceDelay && millis() - buttonDebounce < buttonHoldTimer)
+		uint16_t now = millis();
+
+		// only buttons that changed or wait for the hold time need a look
+		byte check = changed | (down & ~held) | clicked;
+		for (byte i = 0; check; i++, check >>= 1)
 		{
-			// remember to return true only once per button press
-			// to prevent value increase when button is being hold
-			if (!buttonPressUsed && buttonCurrentState == HIGH)
+			if (!(check & 1))
+				continue;
+			byte mask = 1 << i;
+
+			if (changed & mask)
 			{
-				buttonPressUsed = true;
-				return 1;
+				if (down & mask)
+				{
+					pressedAt[i] = now;
+					push(i, BUTTON_PRESS, now);
+				}
+				else
+				{
+					if (!((held | ignored) & mask))
+					{
+						clicked |= mask;
+						clickedAt[i] = now;
+					}
+					held &= ~mask;
+					ignored &= ~mask;
+					push(i, BUTTON_RELEASE, now);
+				}
+			}
+			else if ((down & mask) && !(held & mask))
+			{
+				if ((uint16_t)(now - pressedAt[i]) >= buttonHoldTimer)
+				{
+					held |= mask;
+					push(i, BUTTON_HOLD, now);
+				}
+			}
+			else if ((clicked & mask) && (uint16_t)(now - clickedAt[i]) >= buttonClickTimeout)
+			{
+				clicked &= ~mask;
 			}
-
-			// if not pressed, reset the 'use' variable
-			if (buttonCurrentState == LOW)
-				buttonPressUsed = false;
 		}
+	}
 
-		return 0;
+	/*
+		Takes one snapshot of the buttons for the current frame, call once per
+		frame before reading raw(). Everything read from it during the frame
+		is consistent, and it costs two port reads instead of a digitalRead()
+		per button.
+	*/
+	void sample()
+	{
+		frame = readPins();
 	}
 
+	// raw state of the buttons in the last sample(), bit per button
+	byte frame = 0;
+
 	/*
-		Returns unfiltered state of the button.
-		True if button is pressed, false otherwise.
+		Takes the oldest event from the queue. Returns false if there is none.
 	*/
-	bool raw()
+	bool read(ButtonEvent &event)
 	{
-		return digitalRead(buttonID) == LOW;
+		if (queueTail == queueHead)
+			return false;
+
+		event = queue[queueTail];
+		queueTail = (queueTail + 1) & (buttonEventQueue - 1);
+		return true;
 	}
-};
 
-struct s_button
+	/*
+		Drops all queued events and short presses, for example when
+		switching screens so old presses don't do anything there.
+		Buttons that are down now won't count as pressed when let go.
+	*/
+	void clear()
+	{
+		noInterrupts();
+		queueTail = queueHead;
+		clicked = 0;
+		ignored = pressed;
+		interrupts();
+	}
+
+	// events that didn't fit in the queue
+	byte dropped() const
+	{
+		return queueDropped;
+	}
+
+private:
+	byte ignored = 0; // down during clear()
+	byte count0 = 0xFF, count1 = 0xFF; // vertical debounce counters
+	byte sampleTicks = 0;
+	uint16_t pressedAt[BUTTON_COUNT];
+	uint16_t clickedAt[BUTTON_COUNT];
+
+	/*
+		Queue of events. Only scan() moves the head and only read() moves the tail,
+		both are single bytes, so no locking is needed.
+	*/
+	ButtonEvent queue[buttonEventQueue];
+	volatile byte queueHead = 0;
+	volatile byte queueTail = 0;
+	byte queueDropped = 0;
+
+	void push(byte button, byte type, uint16_t time)
+	{
+		byte next = (queueHead + 1) & (buttonEventQueue - 1);
+		if (next == queueTail)
+		{
+			queueDropped++;
+			return;
+		}
+
+		queue[queueHead] = {button, type, time};
+		queueHead = next;
+	}
+} button;
+
+bool BUTTON::raw()
+{
+	return button.frame & (1 << bit);
+}
+
+int BUTTON::state()
 {
-	BUTTON ok = (A1);
-	BUTTON esc = (A2);
-	BUTTON menu = (A3);
-	BUTTON up = (A4);
-	BUTTON right = (A5);
-	BUTTON down = (4);
-	BUTTON left = (2);
-} button;
\ No newline at end of file
+	byte mask = 1 << bit;
+
+	// take the short press, scan() may be changing it at the same time
+	noInterrupts();
+	byte click = button.clicked & mask;
+	button.clicked &= ~mask;
+	interrupts();
+
+	if (click)
+		return 1;
+
+	if (button.held & mask)
+		return 2;
+
+	return 0;
+}
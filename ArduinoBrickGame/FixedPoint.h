@@ -0,0 +1,84 @@
+#pragma once
+/*
+	Fixed point number for the game physics.
+
+	The Nano has no FPU, every operation on a double (which is a 32 bit float
+	on AVR) is a call into the soft-float library and costs around a hundred
+	cycles. This type is a 16 bit integer with 7 fractional bits (Q9.7):
+		- range is -256 to 255.99, enough for the 128x160 screen
+		- step is 1/128 = 0.0078, fine enough for the ball speeds
+	so adding, subtracting and comparing are single 16 bit instructions.
+
+	Integers convert to it automatically, for fractional constants use the
+	FIXED macro, it is evaluated by the compiler:
+		Fixed speed = FIXED(1.5);
+		if (speed > 2) speed -= FIXED(0.25);
+*/
+#define FIXED_FRACTION_BITS 7
+#define FIXED(value) Fixed::fromRaw((int16_t)((value) * (1 << FIXED_FRACTION_BITS) + ((value) < 0 ? -0.5 : 0.5)))
+
+class Fixed
+{
+private:
+	int16_t raw;
+
+	struct RawTag
+	{
+	};
+	constexpr Fixed(int16_t raw, RawTag) : raw(raw) {}
+
+public:
+	Fixed() = default;
+	constexpr Fixed(int value) : raw(value * (1 << FIXED_FRACTION_BITS)) {}
+
+	static constexpr Fixed fromRaw(int16_t raw)
+	{
+		return Fixed(raw, RawTag());
+	}
+
+	int16_t toRaw() const
+	{
+		return raw;
+	}
+
+	/*
+		Drops the fraction, rounding towards zero like casting a double to int does.
+	*/
+	int toInt() const
+	{
+		return raw < 0 ? -(-raw >> FIXED_FRACTION_BITS) : raw >> FIXED_FRACTION_BITS;
+	}
+
+	Fixed operator-() const
+	{
+		return fromRaw(-raw);
+	}
+	Fixed &operator+=(Fixed other)
+	{
+		raw += other.raw;
+		return *this;
+	}
+	Fixed &operator-=(Fixed other)
+	{
+		raw -= other.raw;
+		return *this;
+	}
+	Fixed &operator*=(int value)
+	{
+		raw *= value;
+		return *this;
+	}
+	Fixed operator*(int value) const
+	{
+		return fromRaw(raw * value);
+	}
+
+	friend Fixed operator+(Fixed a, Fixed b) { return fromRaw(a.raw + b.raw); }
+	friend Fixed operator-(Fixed a, Fixed b) { return fromRaw(a.raw - b.raw); }
+	friend bool operator==(Fixed a, Fixed b) { return a.raw == b.raw; }
+	friend bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw; }
+	friend bool operator<(Fixed a, Fixed b) { return a.raw < b.raw; }
+	friend bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
+	friend bool operator>(Fixed a, Fixed b) { return a.raw > b.raw; }
+	friend bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw; }
+};
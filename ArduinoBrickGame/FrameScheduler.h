@@ -0,0 +1,164 @@
+#pragma once
+/*
+	Fixed timestep frame scheduler.
+
+	Game logic runs in steps of a fixed length, so the game speed doesn't
+	depend on how long drawing takes. Time that passed is collected in an
+	accumulator and as many steps as fit in it are run, so if one frame took
+	longer, the next one catches up. Drawing has its own rate, so physics can
+	run more often than the screen is refreshed.
+
+	If the game can't keep up for longer (more than maxSteps steps are due at
+	once), the extra time is dropped so the game slows down instead of
+	freezing while it catches up. Dropped steps and skipped frames are counted
+	as missed deadlines.
+
+	Usage:
+		FrameScheduler scheduler(25000, 25000);
+		scheduler.begin();
+		while (1)
+		{
+			scheduler.update();
+			while (scheduler.step())
+				simulate();
+			if (scheduler.render())
+				draw();
+		}
+*/
+#define FRAME_SCHEDULER_MAX_STEPS 4 // default catch-up limit
+
+class FrameScheduler
+{
+private:
+	unsigned long stepUs, renderUs;
+	byte maxSteps;
+
+	unsigned long lastUpdate;
+	unsigned long accumulator;
+	unsigned long nextRender;
+	byte stepsThisUpdate;
+
+	unsigned int missedSteps;
+	unsigned int missedFrames;
+
+public:
+	/*
+		stepUs - length of one simulation step in microseconds
+		renderUs - time between two frames in microseconds
+		maxSteps - most steps run in one update before time is dropped
+	*/
+	FrameScheduler(unsigned long stepUs, unsigned long renderUs, byte maxSteps = FRAME_SCHEDULER_MAX_STEPS)
+	{
+		this->stepUs = stepUs;
+		this->renderUs = renderUs;
+		this->maxSteps = maxSteps;
+	}
+
+	/*
+		Starts counting the time from now and clears the missed deadlines.
+		Call before the game loop.
+	*/
+	void begin()
+	{
+		resume();
+		missedSteps = 0;
+		missedFrames = 0;
+	}
+
+	/*
+		Call after anything that paused the game (menus, dialogs),
+		so the time it took is not caught up.
+	*/
+	void resume()
+	{
+		lastUpdate = micros();
+		accumulator = 0;
+		nextRender = lastUpdate;
+		stepsThisUpdate = 0;
+	}
+
+	/*
+		Adds the time passed since last call to the accumulator.
+		Call once per loop, before step().
+	*/
+	void update()
+	{
+		unsigned long now = micros();
+		accumulator += now - lastUpdate;
+		lastUpdate = now;
+		stepsThisUpdate = 0;
+
+		// can't catch up, drop the time we are behind
+		if (accumulator >= stepUs * maxSteps)
+		{
+			unsigned long dropped = accumulator / stepUs - maxSteps;
+			missedSteps += dropped;
+			accumulator -= dropped * stepUs;
+		}
+	}
+
+	/*
+		Returns true if a simulation step should be run now.
+		Call in a loop until it returns false.
+	*/
+	bool step()
+	{
+		if (accumulator < stepUs || stepsThisUpdate >= maxSteps)
+			return false;
+
+		accumulator -= stepUs;
+		stepsThisUpdate++;
+		return true;
+	}
+
+	/*
+		Gives the last step back, if the game could not run it now
+		(for example it is waiting for the other console). It will be
+		due again on the next update().
+	*/
+	void retry()
+	{
+		accumulator += stepUs;
+		stepsThisUpdate = maxSteps;
+	}
+
+	/*
+		Returns true if it's time to draw the next frame.
+	*/
+	bool render()
+	{
+		if ((long)(lastUpdate - nextRender) < 0)
+			return false;
+
+		// whole frames we were late for are skipped
+		unsigned long late = lastUpdate - nextRender;
+		if (late >= renderUs)
+		{
+			missedFrames += late / renderUs;
+			nextRender += (late / renderUs) * renderUs;
+		}
+
+		nextRender += renderUs;
+		return true;
+	}
+
+	/*
+		Returns true if neither a step nor a frame is due yet,
+		so there is time to sleep.
+	*/
+	bool waiting() const
+	{
+		unsigned long passed = micros() - lastUpdate;
+		return accumulator + passed < stepUs && (long)(lastUpdate + passed - nextRender) < 0;
+	}
+
+	unsigned int missedStepCount() const
+	{
+		return missedSteps;
+	}
+
+	unsigned int missedFrameCount() const
+	{
+		return missedFrames;
+	}
+};
@@ -0,0 +1,143 @@
+#pragma once
+#include <new.h>
+#include "ButtonEvent.h"
+#include "FrameScheduler.h"
+#include "Profiler.h"
+#include "Tasks.h"
+
+/*
+	Common interface of the games, and the loop that runs them.
+
+	A game only says what one step, one frame and one button press do,
+	runGame() does the rest the same way for every game: fixed steps and
+	frames paced by the game's FrameScheduler, button events, radio and
+	sleeping between steps.
+
+	Order of the calls:
+		menu()       - the game's own menu, false goes back to the main menu
+		begin()      - new match, draws the whole screen
+		then until quit() is called:
+			update() - one fixed step, as many as the time needs
+			render() - a frame is due, draw what changed
+			send()   - after a frame, netcode sends here
+			receive()- every pass of the loop, netcode reads packets here
+			input()  - every button press
+		end()        - the match is over, final screen
+
+	update() returning false means the step can't run yet (in lockstep the
+	other console's inputs didn't come), it is tried again later and the
+	console sleeps meanwhile.
+
+	Games are listed in Games.h, only the one being played is in RAM.
+
+	Usage:
+		class Snake : public Game
+		{
+		public:
+			Snake() : Game(100000, 100000) {}
+			...
+		};
+*/
+class Game
+{
+private:
+	bool running;
+
+	friend void runGame(Game &game);
+
+protected:
+	FrameScheduler scheduler;
+
+	Game(unsigned long stepUs, unsigned long renderUs) : scheduler(stepUs, renderUs) {}
+
+	// ends the match, end() is called next
+	void quit()
+	{
+		running = false;
+	}
+
+public:
+	virtual ~Game() {}
+
+	virtual bool menu() = 0;
+	virtual void begin() = 0;
+	virtual bool update() = 0;
+	virtual void render() = 0;
+	virtual void send() {}
+	virtual void receive() {}
+	virtual void input(const ButtonEvent &event) = 0;
+	virtual void end() {}
+};
+
+/*
+	Registry entry of a game, see Games.h.
+*/
+struct GameInfo
+{
+	const char *name; // in PROGMEM, row of the games menu
+	Game *(*create)(void *memory);
+};
+
+// constructs the game in the given memory
+template <class T>
+Game *createGame(void *memory)
+{
+	return new (memory) T();
+}
+
+/*
+	Plays one match, from begin() to end().
+*/
+void runGame(Game &game)
+{
+	game.begin();
+	game.running = true;
+	game.scheduler.begin();
+	button.clear();
+
+	while (game.running)
+	{
+		PROFILE_FRAME_BEGIN();
+		game.scheduler.update();
+
+		// all steps of this frame see the same buttons
+		button.sample();
+		bool stalled = false;
+		while (game.running && game.scheduler.step())
+		{
+			PROFILE(PROFILE_PHYSICS);
+
+			if (!game.update())
+			{
+				game.scheduler.retry();
+				stalled = true;
+				break;
+			}
+		}
+
+		bool rendered = game.running && game.scheduler.render();
+		if (rendered)
+		{
+			game.render();
+			game.send();
+		}
+
+		if (game.running)
+			game.receive();
+
+		ButtonEvent event;
+		while (game.running && button.read(event))
+		{
+			if (event.type == BUTTON_PRESS)
+				game.input(event);
+		}
+
+		PROFILE_FRAME_END(rendered);
+
+		// nothing to do until the next step or packet, sleep until an interrupt (~1 ms at most)
+		if (game.running && (stalled || game.scheduler.waiting()))
+			tasks.idle();
+	}
+
+	game.end();
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "Game.h"
+#include "Pong.h"
+#include "Tetris.h"
+
+/*
+	Game registry. The games menu lists these, in this order.
+
+	Adding a game: a class derived from Game (see Game.h), a row here and
+	a member in GameMemory.
+
+	Usage:
+		int game = mainMenu();
+		if (game >= 0)
+			playGame(game);
+*/
+const char _game_pong[] PROGMEM = "Pong";
+const char _game_tetris[] PROGMEM = "Tetris";
+
+const GameInfo games[] PROGMEM = {
+	{_game_pong, createGame<Pong>},
+	{_game_tetris, createGame<Tetris>},
+};
+const byte gameCount = sizeof(games) / sizeof(games[0]);
+
+/*
+	Room for any one of the games, only the one being played is
+	constructed in it. Lives on the stack while a game is played.
+*/
+union GameMemory
+{
+	Pong pong;
+	Tetris tetris;
+
+	GameMemory() {}
+	~GameMemory() {}
+};
+
+/*
+	Shows the game's menu and plays one match, unless the menu was left.
+*/
+void playGame(byte index)
+{
+	GameInfo info;
+	memcpy_P(&info, &games[index], sizeof(info));
+
+	GameMemory memory;
+	Game *game = info.create(&memory);
+
+	display.fillScreen(COLOR_BLACK);
+	if (game->menu())
+		runGame(*game);
+
+	game->~Game();
+}
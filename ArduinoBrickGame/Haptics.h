@@ -0,0 +1,131 @@
+#pragma once
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "Settings.h"
+
+/*
+	Haptics, the vibration motor.
+
+	The motor is on D5, the OC0B output of Timer0, which already runs in
+	fast PWM for millis(). Its strength is OCR0B. Patterns are played from
+	the Timer0 interrupt (tick(), every ~1 ms), so the motor stops by itself
+	at the end of a pattern, whatever loop the sketch is in.
+
+	A pattern is an array of HapticStep in PROGMEM. Every step goes from
+	one strength to another in a straight line (HAPTIC_RAMP) or holds one
+	(HAPTIC_HOLD), pulse trains are holds with 0 between them. The slope
+	of a ramp is worked out once when the step starts, the tick only adds it.
+
+	A pattern that is started cuts the one that was playing. With the
+	vibrations turned off in the settings nothing plays.
+
+	Usage:
+		const HapticStep hapticKnock[] PROGMEM = {HAPTIC_HOLD(255, 40), HAPTIC_HOLD(0, 40), HAPTIC_HOLD(255, 40), HAPTIC_END};
+		haptics.play(hapticKnock);
+		// and haptics.tick() in the Timer0 interrupt
+*/
+#define HAPTIC_UNIT_TICKS 4 // step lengths are counted in 4 Timer0 ticks, ~4 ms
+
+struct HapticStep
+{
+	byte from, to; // PWM strength, 0 - 255
+	byte length;   // in HAPTIC_UNIT_TICKS, 0 ends the pattern
+};
+
+#define HAPTIC_HOLD(level, ms) {level, level, (ms) / HAPTIC_UNIT_TICKS}
+#define HAPTIC_RAMP(from, to, ms) {from, to, (ms) / HAPTIC_UNIT_TICKS}
+#define HAPTIC_END {0, 0, 0}
+
+const HapticStep hapticWallHit[] PROGMEM = {HAPTIC_HOLD(255, 20), HAPTIC_END};
+const HapticStep hapticPointLost[] PROGMEM = {HAPTIC_HOLD(255, 80), HAPTIC_HOLD(0, 40), HAPTIC_HOLD(255, 80), HAPTIC_RAMP(255, 0, 120), HAPTIC_END};
+
+class Haptics
+{
+private:
+	const HapticStep *volatile next = NULL; // next step of the playing pattern
+	volatile uint16_t remaining;			// ticks until the next step
+	uint16_t level;							// strength, 8.8 fixed point
+	int16_t slope;							// added to level every tick
+
+	static void output(byte strength)
+	{
+		OCR0B = strength;
+
+		// at 0 fast PWM would still give a short pulse every period
+		if (strength)
+			TCCR0A |= _BV(COM0B1);
+		else
+			TCCR0A &= ~_BV(COM0B1); // pin back to its port value, low
+	}
+
+	// starts the next step, or stops at the end of the pattern
+	void nextStep()
+	{
+		byte length = pgm_read_byte(&next->length);
+		if (!length)
+		{
+			next = NULL;
+			output(0);
+			return;
+		}
+
+		byte from = pgm_read_byte(&next->from);
+		byte to = pgm_read_byte(&next->to);
+		remaining = length * HAPTIC_UNIT_TICKS;
+		level = from << 8;
+		slope = ((long)(to - from) << 8) / (long)remaining;
+		output(from);
+		next++;
+	}
+
+public:
+	void play(const HapticStep *pattern)
+	{
+		if (!SETTINGS.vibrations)
+			return;
+
+		noInterrupts();
+		next = pattern;
+		nextStep();
+		interrupts();
+	}
+
+	/*
+		Runs the motor at one strength until stop(), for the vibrator test.
+		Not affected by the vibrations setting.
+	*/
+	void set(byte strength)
+	{
+		noInterrupts();
+		next = NULL;
+		output(strength);
+		interrupts();
+	}
+
+	void stop()
+	{
+		set(0);
+	}
+
+	/*
+		Call from the Timer0 interrupt.
+	*/
+	void tick()
+	{
+		if (!next)
+			return;
+
+		if (!--remaining)
+		{
+			nextStep();
+			return;
+		}
+
+		if (slope)
+		{
+			level += slope;
+			output(level >> 8);
+		}
+	}
+} haptics;
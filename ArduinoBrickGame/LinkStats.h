@@ -0,0 +1,141 @@
+#pragma once
+
+/*
+	Radio link statistics, for tuning PA level, channel and send rate.
+
+	Collected all the time the radio is used (wireless test and multiplayer
+	games) and kept until reset, so several matches can be compared.
+	RadioLink records what it sends, the game records sequence numbers of
+	what it receives:
+		sent / delivered - packets sent and how many got through
+		retries          - auto retransmits (ARC of the radio), total and most for one packet
+		round trip       - from sending a packet until its acknowledgement came,
+		                   histogram with buckets doubling from LINK_STATS_FIRST_US
+		received         - packets with a sequence number
+		missed           - sequence numbers skipped (lost, or replaced before sending)
+		out of order     - packets older than one already received
+
+	Shown in the test menu, and printed to Serial as "name,value" lines.
+*/
+#define LINK_STATS_BUCKETS 10
+#define LINK_STATS_FIRST_US 500 // bucket i counts round trips below 500 us << i, last one the rest
+#define LINK_STATS_BAUD 115200
+
+struct LinkStats
+{
+	uint16_t sent, delivered;
+	uint16_t retries;
+	byte maxRetries;
+	uint16_t received, missed, outOfOrder;
+	uint16_t roundTrip[LINK_STATS_BUCKETS];
+
+	byte lastSeq;
+	bool hasSeq;
+
+	// counters stop at the maximum instead of wrapping
+	static void add(uint16_t &counter, uint16_t value = 1)
+	{
+		counter = counter > 0xFFFF - value ? 0xFFFF : counter + value;
+	}
+
+	void reset()
+	{
+		memset(this, 0, sizeof(*this));
+	}
+
+	/*
+		A packet was sent, arc is the number of retransmits it took.
+	*/
+	void transmitted(bool ok, byte arc)
+	{
+		add(sent);
+		if (ok)
+			add(delivered);
+
+		add(retries, arc);
+		if (arc > maxRetries)
+			maxRetries = arc;
+	}
+
+	void roundTripTime(unsigned long us)
+	{
+		byte bucket = 0;
+		while (bucket < LINK_STATS_BUCKETS - 1 && us >= (unsigned long)LINK_STATS_FIRST_US << bucket)
+			bucket++;
+		add(roundTrip[bucket]);
+	}
+
+	/*
+		Sequence number of a received packet (8 bit, wraps around).
+	*/
+	void sequence(byte seq)
+	{
+		add(received);
+
+		int8_t diff = seq - lastSeq;
+		if (hasSeq && diff <= 0)
+		{
+			add(outOfOrder);
+			return;
+		}
+
+		if (hasSeq)
+			add(missed, diff - 1);
+		lastSeq = seq;
+		hasSeq = true;
+	}
+
+	/*
+		Call when a new game starts, the other console starts numbering again.
+	*/
+	void newSequence()
+	{
+		hasSeq = false;
+	}
+
+	// percent of sent packets that didn't get through
+	byte lossPercent() const
+	{
+		return sent ? (unsigned long)(sent - delivered) * 100 / sent : 0;
+	}
+
+	// upper limit of a round trip bucket in us, 0 for the last one
+	static unsigned long bucketLimit(byte bucket)
+	{
+		return bucket < LINK_STATS_BUCKETS - 1 ? (unsigned long)LINK_STATS_FIRST_US << bucket : 0;
+	}
+
+	void print(Print &out) const
+	{
+		out.print(F("sent,"));
+		out.println(sent);
+		out.print(F("delivered,"));
+		out.println(delivered);
+		out.print(F("retries,"));
+		out.println(retries);
+		out.print(F("max_retries,"));
+		out.println(maxRetries);
+		out.print(F("received,"));
+		out.println(received);
+		out.print(F("missed,"));
+		out.println(missed);
+		out.print(F("out_of_order,"));
+		out.println(outOfOrder);
+
+		for (byte i = 0; i < LINK_STATS_BUCKETS; i++)
+		{
+			if (bucketLimit(i))
+			{
+				out.print(F("rtt_below_"));
+				out.print(bucketLimit(i));
+			}
+			else
+			{
+				out.print(F("rtt_from_"));
+				out.print(bucketLimit(i - 1));
+			}
+			out.print(F("_us,"));
+			out.println(roundTrip[i]);
+		}
+	}
+} linkStats;
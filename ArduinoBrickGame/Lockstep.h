@@ -0,0 +1,159 @@
+#pragma once
+
+/*
+	Lockstep multiplayer.
+
+	Both consoles run the same simulation of the whole game and only send
+	each other the buttons pressed in every step. Pong physics uses only
+	integers and Fixed, so with the same inputs both sides always get
+	exactly the same game and nobody has to own the ball.
+
+	Input of a step is used LOCKSTEP_INPUT_DELAY steps later, so it has time
+	to get to the other console. If it didn't come yet the game waits.
+	Every packet repeats all inputs the other side hasn't confirmed yet, so
+	a lost packet is covered by the next one.
+
+	Packet layout:
+		byte 0    - bits 0-2 version (LOCKSTEP_VERSION), bit 3 quit, bits 4-7 number of inputs
+		byte 1-2  - frame of the first input
+		byte 3-4  - next frame of the other console's input this console needs (ack)
+		inputs, 2 bits each (what they mean is up to the game), packed from the lowest bit
+
+	Version is in the same bits as in NetPacket.h, so the two can't be mixed up.
+
+	Usage, every step:
+		byte local, remote;
+		if (lockstep.advance(buttons, local, remote))
+			simulate(local, remote);
+*/
+#define LOCKSTEP_VERSION 2
+#define LOCKSTEP_INPUT_DELAY 4 // steps
+#define LOCKSTEP_WINDOW 16	   // inputs kept, must be a power of 2
+#define LOCKSTEP_MAX_INPUTS 15 // most inputs in one packet
+#define LOCKSTEP_PACKET_MAX (5 + (LOCKSTEP_MAX_INPUTS * 2 + 7) / 8)
+
+class Lockstep
+{
+private:
+	byte localInputs[LOCKSTEP_WINDOW];
+	byte remoteInputs[LOCKSTEP_WINDOW];
+
+	uint16_t frame;		  // next frame to simulate
+	uint16_t remoteFrame; // remote inputs are known for all frames before this one
+	uint16_t remoteAck;	  // other console has local inputs for all frames before this one
+	bool remoteQuit;
+
+	// a is later than b, works across the 16 bit wrap
+	static bool after(uint16_t a, uint16_t b)
+	{
+		return (int16_t)(a - b) > 0;
+	}
+
+public:
+	/*
+		First LOCKSTEP_INPUT_DELAY frames have no buttons pressed on both sides.
+	*/
+	void begin()
+	{
+		memset(localInputs, 0, sizeof(localInputs));
+		memset(remoteInputs, 0, sizeof(remoteInputs));
+		frame = 0;
+		remoteFrame = LOCKSTEP_INPUT_DELAY;
+		remoteAck = LOCKSTEP_INPUT_DELAY;
+		remoteQuit = false;
+	}
+
+	/*
+		Returns inputs of both consoles for the next frame and stores this
+		console's input for LOCKSTEP_INPUT_DELAY frames later.
+		Returns false if the other console's input didn't come yet,
+		the frame has to wait then.
+	*/
+	bool advance(byte input, byte &local, byte &remote)
+	{
+		if (!after(remoteFrame, frame))
+			return false;
+
+		local = localInputs[frame % LOCKSTEP_WINDOW];
+		remote = remoteInputs[frame % LOCKSTEP_WINDOW];
+		localInputs[(frame + LOCKSTEP_INPUT_DELAY) % LOCKSTEP_WINDOW] = input;
+		frame++;
+		return true;
+	}
+
+	/*
+		Writes a packet with all inputs the other console doesn't have yet,
+		returns its length.
+	*/
+	byte encode(byte *out, bool quit = false)
+	{
+		uint16_t end = frame + LOCKSTEP_INPUT_DELAY; // local inputs are known up to here
+		uint16_t first = remoteAck;
+		if ((uint16_t)(end - first) > LOCKSTEP_MAX_INPUTS)
+			first = end - LOCKSTEP_MAX_INPUTS;
+		byte count = end - first;
+
+		out[0] = LOCKSTEP_VERSION | (quit << 3) | (count << 4);
+		out[1] = first;
+		out[2] = first >> 8;
+		out[3] = remoteFrame;
+		out[4] = remoteFrame >> 8;
+
+		memset(out + 5, 0, (count * 2 + 7) / 8);
+		for (byte i = 0; i < count; i++)
+		{
+			byte input = localInputs[(first + i) % LOCKSTEP_WINDOW] & 0x03;
+			out[5 + i / 4] |= input << ((i % 4) * 2);
+		}
+
+		return 5 + (count * 2 + 7) / 8;
+	}
+
+	/*
+		Takes the inputs from a packet of the other console.
+		Returns false if it is not a lockstep packet.
+	*/
+	bool decode(const byte *in, byte length)
+	{
+		if (length < 5 || (in[0] & 0x07) != LOCKSTEP_VERSION)
+			return false;
+
+		byte count = in[0] >> 4;
+		if (length < 5 + (count * 2 + 7) / 8)
+			return false;
+
+		if (in[0] & 0x08)
+			remoteQuit = true;
+
+		uint16_t first = in[1] | (in[2] << 8);
+		uint16_t ack = in[3] | (in[4] << 8);
+		if (after(ack, remoteAck))
+			remoteAck = ack;
+
+		for (byte i = 0; i < count; i++)
+		{
+			uint16_t inputFrame = first + i;
+
+			// only the next missing one, older are known, later can't be stored yet
+			if (inputFrame != remoteFrame || (uint16_t)(inputFrame - frame) >= LOCKSTEP_WINDOW)
+				continue;
+
+			remoteInputs[inputFrame % LOCKSTEP_WINDOW] = (in[5 + i / 4] >> ((i % 4) * 2)) & 0x03;
+			remoteFrame++;
+		}
+
+		return true;
+	}
+
+	// true if the other console left the game
+	bool quit() const
+	{
+		return remoteQuit;
+	}
+
+	// next frame to simulate
+	uint16_t currentFrame() const
+	{
+		return frame;
+	}
+};
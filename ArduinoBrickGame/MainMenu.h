@@ -2,8 +2,16 @@
 #include <SPI.h>
 #include <Adafruit_ST7735.h> // https://github.com/adafruit/Adafruit-ST7735-Library library for ST7735
 #include <RF24.h>			 // https://github.com/nRF24/RF24 - RF24 by TMRh20
+#include "Battery.h"
 #include "ButtonEvent.h"
+#include "Game.h"
+#include "Haptics.h"
+#include "LinkStats.h"
+#include "Power.h"
+#include "RadioLink.h"
 #include "Settings.h"
+#include "Sound.h"
+#include "Tasks.h"
 
 /*
 	If this is set to 1, test menu is completely disabled.
@@ -15,35 +23,61 @@
 #define BUZZER 3
 #define VIBR 5
 
+// joining console sends empty packets this often in the wireless test, host's answers come back with them
+#define WIRELESS_TEST_POLL 20 // ms
+
 // all objects defined in main .ino file that will also be used here
 extern Adafruit_ST7735 display;
 extern RF24 radio;
-extern const byte BATTERY;
 
 /*
-	All string constants for menu options.
-	Holding them in this way uses PROGMEM rather than RAM
-	from https://playground.arduino.cc/Main/PROGMEM/
+	Menus are tables in PROGMEM, drawn and navigated by MenuEngine (below).
+	Every item is one of:
+		MENU_ACTION  - MenuEngine::run() returns its action, the caller does the rest
+		MENU_TOGGLE  - flips a bool setting, ON / OFF is shown next to it
+		MENU_SUBMENU - opens another menu, esc / left goes back
+
+	A menu without items lists the games of the registry (see Games.h),
+	each row returns ACTION_GAME + its index.
 
-	First position is "Title" that will be on the top of the screen,
-	rest are the options that user can select.
+	Strings are in PROGMEM too, from https://playground.arduino.cc/Main/PROGMEM/
 */
+#define MENU_ACTION 0
+#define MENU_TOGGLE 1
+#define MENU_SUBMENU 2
 
-// If making changes to main menu, search for "CHANGE ME IF MAKING CHANGES TO MAIN MENU" and change code there
-const char _menu_main_0[] PROGMEM = "Arduino Brick Game";
-const char _menu_main_1[] PROGMEM = "Play";
-const char _menu_main_2[] PROGMEM = "Options";
-const char _menu_main_3[] PROGMEM = "Info";
-#if DISABLE_TEST_MENU == 0
-const char _menu_main_4[] PROGMEM = "Test";
-const char *const menuMain[] PROGMEM = {_menu_main_0, _menu_main_1, _menu_main_2, _menu_main_3, _menu_main_4};
-#else
-const char *const menuMain[] PROGMEM = {_menu_main_0, _menu_main_1, _menu_main_2, _menu_main_3};
-#endif
+struct MenuItem
+{
+	const char *text; // in PROGMEM
+	byte type;
+	const void *target; // MENU_TOGGLE - the bool, MENU_SUBMENU - the Menu
+	byte action;		// MENU_ACTION - returned by MenuEngine::run()
+};
+
+struct Menu
+{
+	const char *title; // in PROGMEM
+	const MenuItem *items; // NULL - the games
+	byte count;
+};
+
+// the game registry, defined in Games.h
+extern const GameInfo games[];
+extern const byte gameCount;
+
+#define MENU_ITEMS(items) items, sizeof(items) / sizeof(MenuItem)
+
+// actions of the main menu tree
+#define ACTION_GAME 0 // + index in the game registry
+#define ACTION_INFO 20
+#define ACTION_SAVE 21
+#define ACTION_ID_0 22
+#define ACTION_ID_1 23
+#define ACTION_DEFAULTS 24
+#define ACTION_TEST 30 // + row in the test menu
 
 const char _menu_play_0[] PROGMEM = "Games";
-const char _menu_play_1[] PROGMEM = "Pong";
-const char *const menuPlay[] PROGMEM = {_menu_play_0, _menu_play_1};
+const Menu menuPlay PROGMEM = {_menu_play_0, NULL, 0};
 
 #if DISABLE_TEST_MENU == 0
 const char _menu_test_0[] PROGMEM = "Test menu";
@@ -53,7 +87,19 @@ const char _menu_test_3[] PROGMEM = "Wireless";
 const char _menu_test_4[] PROGMEM = "Buttons";
 const char _menu_test_5[] PROGMEM = "Colors";
 const char _menu_test_6[] PROGMEM = "Colors 2";
-const char *const menuTest[] PROGMEM = {_menu_test_0, _menu_test_1, _menu_test_2, _menu_test_3, _menu_test_4, _menu_test_5, _menu_test_6};
+const char _menu_test_7[] PROGMEM = "Link stats";
+const char _menu_test_8[] PROGMEM = "Power";
+const MenuItem menuTestItems[] PROGMEM = {
+	{_menu_test_1, MENU_ACTION, NULL, ACTION_TEST + 0},
+	{_menu_test_2, MENU_ACTION, NULL, ACTION_TEST + 1},
+	{_menu_test_3, MENU_ACTION, NULL, ACTION_TEST + 2},
+	{_menu_test_4, MENU_ACTION, NULL, ACTION_TEST + 3},
+	{_menu_test_5, MENU_ACTION, NULL, ACTION_TEST + 4},
+	{_menu_test_6, MENU_ACTION, NULL, ACTION_TEST + 5},
+	{_menu_test_7, MENU_ACTION, NULL, ACTION_TEST + 6},
+	{_menu_test_8, MENU_ACTION, NULL, ACTION_TEST + 7},
+};
+const Menu menuTest PROGMEM = {_menu_test_0, MENU_ITEMS(menuTestItems)};
 #endif
 
 const char _menu_options_0[] PROGMEM = "Options";
@@ -63,7 +109,30 @@ const char _menu_options_21[] PROGMEM = "Save to EEPROM";
 const char _menu_options_3[] PROGMEM = "Set console ID 0";
 const char _menu_options_4[] PROGMEM = "Set console ID 1";
 const char _menu_options_5[] PROGMEM = "Reset to default";
-const char *const menuOptions[] PROGMEM = {_menu_options_0, _menu_options_1, _menu_options_2, _menu_options_21, _menu_options_3, _menu_options_4, _menu_options_5};
+const MenuItem menuOptionsItems[] PROGMEM = {
+	{_menu_options_1, MENU_TOGGLE, &SETTINGS.vibrations, 0},
+	{_menu_options_2, MENU_TOGGLE, &SETTINGS.sound, 0},
+	{_menu_options_21, MENU_ACTION, NULL, ACTION_SAVE},
+	{_menu_options_3, MENU_ACTION, NULL, ACTION_ID_0},
+	{_menu_options_4, MENU_ACTION, NULL, ACTION_ID_1},
+	{_menu_options_5, MENU_ACTION, NULL, ACTION_DEFAULTS},
+};
+const Menu menuOptions PROGMEM = {_menu_options_0, MENU_ITEMS(menuOptionsItems)};
+
+const char _menu_main_0[] PROGMEM = "Arduino Brick Game";
+const char _menu_main_1[] PROGMEM = "Play";
+const char _menu_main_2[] PROGMEM = "Options";
+const char _menu_main_3[] PROGMEM = "Info";
+const char _menu_main_4[] PROGMEM = "Test";
+const MenuItem menuMainItems[] PROGMEM = {
+	{_menu_main_1, MENU_SUBMENU, &menuPlay, 0},
+	{_menu_main_2, MENU_SUBMENU, &menuOptions, 0},
+	{_menu_main_3, MENU_ACTION, NULL, ACTION_INFO},
+#if DISABLE_TEST_MENU == 0
+	{_menu_main_4, MENU_SUBMENU, &menuTest, 0},
+#endif
+};
+const Menu menuMain PROGMEM = {_menu_main_0, MENU_ITEMS(menuMainItems)};
 
 const int menuOptionX = 20, menuOptionY = 40, menuOptionHeight = 9;
 
@@ -80,30 +149,7 @@ const unsigned char bitmapVibr[] PROGMEM = {
 	0x00, 0x00, 0x80, 0x40, 0x5e, 0x80, 0x92, 0x40, 0x52, 0x80, 0x92, 0x40, 0x52, 0x80, 0x9e, 0x40,
 	0x40, 0x80, 0x00, 0x00};
 
-int playMenu();
-void testMenu(), infoMenu(), optionsMenu(), drawInfoPanel();
-
-/*
-	To make printing the string from the progmem easier.
-	Can be used like:
-		printProgmem(&(menuMain[0]));
-
-	x - optional parameter, where to set the cursor for printing
-	y - optional parameter, where to set the cursor for printing
-*/
-void printProgmem(const char *const *string, int x = -1, int y = -1)
-{
-	char *buffer = new char[strlen(*string) + 1];
-	strcpy_P(buffer, (char *)pgm_read_ptr(string));
-
-	if (x >= 0 && y >= 0)
-	{
-		display.setCursor(x, y);
-	}
-
-	display.print(buffer);
-	delete buffer;
-}
+void testMenu(byte test), infoMenu(), drawInfoPanel();
 
 /*
 	Another print helper function. Works with F macro.
@@ -137,24 +183,6 @@ void printCentered(char *str, int y)
 	display.print(str);
 }
 
-/*
-	Used to draw menu from the PROGMEM char arrays.
-	Use the drawMenu macro to print.
-	Use like: drawMenu(menuMain);
-*/
-#define drawMenu(progmemArr) _drawMenu(progmemArr, sizeof(progmemArr) / sizeof(char *))
-void _drawMenu(const char *const *menu, const int menuSize)
-{
-	display.fillScreen(0);
-	drawInfoPanel();
-	printProgmem(&(menu[0]), 10, 0);
-
-	for (int i = 1; i < menuSize; i++)
-	{
-		printProgmem(&(menu[i]), menuOptionX, menuOptionY + menuOptionHeight * (i - 1));
-	}
-}
-
 /*
 	Used to draw the arrow cursor that points to the menu option.
 	If calling first time for the given menu, pass with (>=0, maxPosition) arguments.
@@ -200,10 +228,14 @@ byte getMenuSelector(int reset = -1, int maxPosition = -1)
 			menuSelector = maxMenuSelector;
 		else
 			menuSelector--;
+		sound.play(soundMenuClick);
 	}
 
 	if (button.down.state())
+	{
 		menuSelector++;
+		sound.play(soundMenuClick);
+	}
 
 	return menuSelector;
 }
@@ -219,24 +251,17 @@ void drawInfoPanel()
 	const int yOffset = 160 - 10;
 
 	// print battery icon
-	double voltage = analogRead(BATTERY) * 5.0 / 1024.0;
-	if (voltage > 4.2)
-		voltage = 4.2;
-	if (voltage < 3.5)
-		voltage = 3.5;
-
-	uint16_t color = COLOR_WHITE;
-	if (voltage < 3.5)
-		color = COLOR_RED;
+	int voltage = constrain(battery.millivolts(), BATTERY_EMPTY_MV, BATTERY_FULL_MV);
 	display.drawBitmap(xOffset, yOffset, bitmapBattery, 18, 10, COLOR_WHITE);
 
-	// fill battery icon
-	color = COLOR_GREEN;
-	if (voltage < 3.8)
+	// fill battery icon, cleared first as it is drawn again when the battery gets low
+	uint16_t color = COLOR_GREEN;
+	if (voltage < 3800)
 		color = COLOR_GREEN | COLOR_RED;
-	if (voltage < 3.5)
+	if (battery.low())
 		color = COLOR_RED;
-	display.fillRect(xOffset + 2, yOffset + 3, map(voltage * 10, 35, 42, 0, 14), 4, color);
+	display.fillRect(xOffset + 2, yOffset + 3, 14, 4, COLOR_BLACK);
+	display.fillRect(xOffset + 2, yOffset + 3, map(voltage, BATTERY_EMPTY_MV, BATTERY_FULL_MV, 0, 14), 4, color);
 
 	// print the speaker icon
 	color = COLOR_RED;
@@ -251,551 +276,792 @@ void drawInfoPanel()
 	display.drawBitmap(xOffset - 24, yOffset, bitmapVibr, 10, 10, color);
 }
 
-#if DISABLE_TEST_MENU == 0
-bool sendTimeWireless(unsigned long time)
-{
-	// prepare to transmit data
-	radio.stopListening();
-	bool radioResult = radio.write(&time, sizeof(time));
-	radio.startListening();
-	return radioResult;
-}
-#endif
 /*
-	Returns -1 if no option was selected. Otherwise returns which game was selected.
+	Draws and runs the menus described by the tables above.
+
+	Only what changed is drawn: moving the cursor redraws the arrow (see
+	getMenuSelector), a toggle redraws its ON / OFF and the icons, going to
+	a submenu or back clears just the title and the rows. The whole screen
+	is drawn only the first time and after an action, which draws its own.
+
+	Usage:
+		menus.open(&menuMain);
+		while (1)
+		{
+			int action = menus.run(); // returns when an action was picked
+			if (action == MENU_BACK)
+				break;
+			...
+		}
 */
-int mainMenu()
+#define MENU_BACK -1 // run() result when leaving the first menu
+#define MENU_DEPTH 3 // menus open at once
+
+class MenuEngine
 {
-	byte menuSelector = 0;
+private:
+	const Menu *stack[MENU_DEPTH];
+	byte selectors[MENU_DEPTH]; // cursor position in each open menu
+	byte depth;
+	Menu menu; // copy of stack[depth] from PROGMEM
+	bool screenValid;
+
+	static void readItem(byte row, const Menu &from, MenuItem &item)
+	{
+		if (from.items)
+			memcpy_P(&item, &from.items[row], sizeof(item));
+		else
+			item = {(const char *)pgm_read_ptr(&games[row].name), MENU_ACTION, NULL, (byte)(ACTION_GAME + row)};
+	}
 
-	while (1)
+	static int rowY(byte row)
 	{
-		drawMenu(menuMain);
+		return menuOptionY + menuOptionHeight * row;
+	}
 
-		// calling it with menuSelector as parameter will make it try to restore last cursor position in this menu
-		menuSelector = getMenuSelector(menuSelector, sizeof(menuMain) / sizeof(char *) - 2);
+	void drawToggle(byte row, const MenuItem &item)
+	{
+		display.fillRect(100, rowY(row), 128 - 100, 8, COLOR_BLACK);
+		printOnOff(*(const bool *)item.target, rowY(row));
+	}
+
+	// title, rows and the cursor of the current menu
+	void drawMenu()
+	{
+		memcpy_P(&menu, stack[depth], sizeof(menu));
+		if (!menu.items)
+			menu.count = gameCount;
+
+		print((const __FlashStringHelper *)menu.title, 10, 0);
+
+		for (byte row = 0; row < menu.count; row++)
+		{
+			MenuItem item;
+			readItem(row, menu, item);
+			print((const __FlashStringHelper *)item.text, menuOptionX, rowY(row));
+
+			if (item.type == MENU_TOGGLE)
+				drawToggle(row, item);
+		}
+
+		getMenuSelector(selectors[depth], menu.count - 1);
+	}
+
+	// clears what drawMenu() drew
+	void eraseMenu()
+	{
+		display.fillRect(0, 0, 128, 8, COLOR_BLACK);
+		display.fillRect(0, menuOptionY, 128, menuOptionHeight * menu.count, COLOR_BLACK);
+	}
+
+public:
+	/*
+		Starts at the given menu, the cursor on the first row.
+	*/
+	void open(const Menu *first)
+	{
+		stack[0] = first;
+		selectors[0] = 0;
+		depth = 0;
+		screenValid = false;
+	}
+
+	/*
+		Shows the menus until an action is picked and returns it, or
+		MENU_BACK if the first menu was left. Call again to come back to
+		the same menu and row.
+	*/
+	int run()
+	{
+		if (!screenValid)
+		{
+			display.fillScreen(COLOR_BLACK);
+			drawInfoPanel();
+			drawMenu();
+			screenValid = true;
+		}
 
 		while (1)
 		{
-			menuSelector = getMenuSelector();
+			byte row = getMenuSelector();
 
-			// if selected some option:
 			if (button.ok.state() == 1 || button.right.state() == 1)
 			{
-				/*
-					CHANGE ME IF MAKING CHANGES TO MAIN MENU
-				*/
+				MenuItem item;
+				readItem(row, menu, item);
+				selectors[depth] = row;
+				sound.play(soundMenuClick);
 
-				if (menuSelector == 0)
+				if (item.type == MENU_ACTION)
 				{
-					int returned = playMenu();
-					if (returned != -1)
-						return returned;
+					screenValid = false;
+					return item.action;
 				}
-				else if (menuSelector == 1)
+				else if (item.type == MENU_TOGGLE)
 				{
-					optionsMenu();
+					bool *value = (bool *)item.target;
+					*value = !*value;
+					drawToggle(row, item);
+					drawInfoPanel();
 				}
-				else if (menuSelector == 2)
+				else if (depth < MENU_DEPTH - 1)
 				{
-					infoMenu();
+					eraseMenu();
+					stack[++depth] = (const Menu *)item.target;
+					selectors[depth] = 0;
+					drawMenu();
 				}
-				else
+			}
+
+			if (button.esc.state() == 1 || (depth > 0 && button.left.state() == 1))
+			{
+				sound.play(soundMenuClick);
+
+				if (depth == 0)
 				{
-#if DISABLE_TEST_MENU == 0
-					testMenu();
-#endif
+					screenValid = false;
+					return MENU_BACK;
 				}
 
-				// set so this function resets after returning from whatever was picked by the user
-				break;
+				eraseMenu();
+				depth--;
+				drawMenu();
 			}
 
-			if (button.esc.state() == 1)
-				return -1;
+			// battery icon turns red
+			if (battery.lowEvent())
+				drawInfoPanel();
+
+			tasks.idle();
 		}
 	}
-}
+} menus;
 
-int playMenu()
+#if DISABLE_TEST_MENU == 0
+bool sendTimeWireless(unsigned long time)
 {
-	drawMenu(menuPlay);
-	byte menuSelector = getMenuSelector(0, sizeof(menuPlay) / sizeof(char *) - 2);
+	// host's answer goes back with the next packet of the other console, see RadioLink.h
+	return radioLink.send(&time, sizeof(time));
+}
 
-	while (1)
+/*
+	Shows what LinkStats collected, round trips as a histogram.
+*/
+void drawLinkStats()
+{
+	display.fillScreen(COLOR_BLACK);
+	print(F("Link stats"), 0, 0, COLOR_RED | COLOR_GREEN);
+
+	print(F("Sent "), 0, 12);
+	print(linkStats.sent);
+	print(F(" lost "));
+	print(linkStats.lossPercent());
+	print(F("%"));
+	print(F("Retries "), 0, 22);
+	print(linkStats.retries);
+	print(F(" max "));
+	print(linkStats.maxRetries);
+	print(F("Received "), 0, 32);
+	print(linkStats.received);
+	print(F("Missed "), 0, 42);
+	print(linkStats.missed);
+	print(F(" late "));
+	print(linkStats.outOfOrder);
+
+	print(F("Round trip"), 0, 54);
+	uint16_t most = 1;
+	for (byte i = 0; i < LINK_STATS_BUCKETS; i++)
+		most = max(most, linkStats.roundTrip[i]);
+
+	for (byte i = 0; i < LINK_STATS_BUCKETS; i++)
 	{
-		menuSelector = getMenuSelector();
+		int y = 64 + i * 8;
+		unsigned long limit = LinkStats::bucketLimit(i);
 
-		// launch
-		if (button.ok.state() == 1 || button.right.state() == 1)
+		if (limit)
+			print(F("<"), 0, y);
+		else
 		{
-			return menuSelector;
+			print(F(">"), 0, y);
+			limit = LinkStats::bucketLimit(i - 1);
 		}
 
-		// escape
-		if (button.left.state() == 1 || button.esc.state() == 1)
-		{
+		if (limit < 1000)
+			print(F("0.5"));
+		else
+			print(limit / 1000);
+		print(F("ms"));
+
+		display.fillRect(42, y, (unsigned long)linkStats.roundTrip[i] * 50 / most, 7, COLOR_GREEN);
+		print(linkStats.roundTrip[i], 96, y);
+	}
+
+	print(F("OK-Serial MENU-reset"), 0, 152, COLOR_BLUE | COLOR_GREEN);
+}
+#endif
+/*
+	Returns -1 if no option was selected. Otherwise returns the index of the game
+	that was selected in the registry (see Games.h).
+*/
+int mainMenu()
+{
+	menus.open(&menuMain);
+
+	while (1)
+	{
+		int action = menus.run();
+
+		if (action == MENU_BACK)
 			return -1;
+		else if (action < ACTION_GAME + gameCount)
+			return action - ACTION_GAME;
+		else if (action == ACTION_INFO)
+			infoMenu();
+		else if (action == ACTION_SAVE)
+			saveSettings();
+		else if (action == ACTION_ID_0 || action == ACTION_ID_1)
+		{
+			SETTINGS.id = action - ACTION_ID_0;
+			saveSettings();
+
+			display.fillScreen(COLOR_BLACK);
+			print(F("ID of this console"), 0, 0, COLOR_WHITE);
+			print(F("is set to "), 0, 10);
+			print(SETTINGS.id);
+			print(F("Restart required."), 0, 50, COLOR_RED | COLOR_GREEN);
+			print(F("Turn the console OFF"), 0, 60, COLOR_RED);
+
+			while (1)
+				tasks.idle();
 		}
+		else if (action == ACTION_DEFAULTS)
+			defaultSettings();
+#if DISABLE_TEST_MENU == 0
+		else if (action >= ACTION_TEST)
+			testMenu(action - ACTION_TEST);
+#endif
 	}
 }
 
 #if DISABLE_TEST_MENU == 0
-void testMenu()
+/*
+	Runs one of the tests, test is its row in the test menu.
+*/
+void testMenu(byte test)
 {
-	byte menuSelector = 0;
+	display.fillScreen(0);
+	display.setCursor(0, 0);
 
-	while (1)
+	if (test == 0) // buzzer
 	{
-		drawMenu(menuTest);
+		int valueToWrite = 1000;
+		int lastValue = -1;
+		int playingValue = -1; // frequency the buzzer plays, -1 - silent
 
-		// calling it with menuSelector as parameter will make it try to restore last cursor position in this menu
-		menuSelector = getMenuSelector(menuSelector, sizeof(menuTest) / sizeof(char *) - 2);
+		print(F("Buzzer test"));
+		print(F("Hold OK to test"), 10, 30);
+		print(F("Frequency: "), 10, 40);
 
 		while (1)
 		{
-			menuSelector = getMenuSelector();
+			if (valueToWrite != lastValue)
+			{
+				if (valueToWrite < 0)
+					valueToWrite = 0;
+				if (valueToWrite > 20000)
+					valueToWrite = 20000;
 
-			// if selected some option:
-			if (button.ok.state() == 1 || button.right.state() == 1)
+				print(lastValue, 10, 50, ST7735_BLACK);
+				print(F(" hz"), -1, -1, ST7735_BLACK);
+
+				print(valueToWrite, 10, 50);
+				print(F(" hz"));
+
+				lastValue = valueToWrite;
+			}
+
+			if (button.up.state())
+				valueToWrite += 10;
+			if (button.down.state())
+				valueToWrite -= 10;
+			if (button.esc.state() == 1 || button.left.state() == 1)
+			{
+				sound.stop();
+				break;
+			}
+
+			// Timer2 restarts on every tone(), so only when the frequency changes
+			if (button.ok.state() == 2)
+			{
+				if (playingValue != valueToWrite)
+				{
+					sound.tone(valueToWrite);
+					playingValue = valueToWrite;
+				}
+			}
+			else if (playingValue != -1)
+			{
+				sound.stop();
+				playingValue = -1;
+			}
+
+			tasks.idle();
+		}
+	}
+	else if (test == 1) // vibrator
+	{
+
+		int valueToWrite = 1000; // set to max
+		int lastValue = -1;
+		int writtenValue = -1; // PWM the motor runs at, -1 - stopped
+
+		print(F("Vibrator test"));
+		print(F("Hold OK to test"), 10, 30);
+		print(F("PWM value: "), 10, 40);
+
+		while (1)
+		{
+			if (valueToWrite != lastValue)
+			{
+				if (valueToWrite < 0)
+					valueToWrite = 0;
+				if (valueToWrite > 255)
+					valueToWrite = 255;
+
+				print(lastValue, 10, 50, ST77XX_BLACK);
+				print(F(" / 255"), -1, -1, ST77XX_BLACK);
+
+				print(valueToWrite, 10, 50);
+				print(F(" / 255"));
+
+				lastValue = valueToWrite;
+			}
+
+			if (button.up.state())
+				valueToWrite += 10;
+			if (button.down.state())
+				valueToWrite -= 10;
+			if (button.esc.state() == 1 || button.left.state() == 1)
+			{
+				haptics.stop();
+				break;
+			}
+
+			if (button.ok.state() == 2)
+			{
+				if (writtenValue != valueToWrite)
+				{
+					haptics.set(valueToWrite);
+					writtenValue = valueToWrite;
+				}
+			}
+			else if (writtenValue != -1)
+			{
+				haptics.stop();
+				writtenValue = -1;
+			}
+
+			tasks.idle();
+		}
+	}
+	else if (test == 2) // wireless
+	{
+		print(F("Wireless test"));
+		print(F("This is radio #"), 0, 30);
+		print(SETTINGS.id);
+		print(F("Press OK to try to\ncommunicate"), 0, 40);
+		print(F("Received ping in"), 0, 100);
+		print(F("-"), 0, 110);
+
+		unsigned long timeSend = millis(); // randomize this number, so the display will update
+		unsigned long lastTimeSend = 0;
+		unsigned long timeReceived = 0;
+		unsigned long lastTimeReceived = timeSend; // again, so the display updates
+		unsigned long lastDisplayUpdate = 0;
+		unsigned long timeAnyMsgReceived = 0; // used for ping received message
+		unsigned long lastPoll = 0;
+		unsigned long pingSentAt = 0; // micros(), when this console's ping left
+		unsigned long pingUs = 0;	  // round trip of the last ping
+		bool pingRequested = false;
+		bool pingWaiting = false;
+
+		bool removePingInfo = 0;
+		bool removePingInfo2 = 0;
+
+		power.radioOn();
+		radioLink.startSession(SETTINGS.id == 0 ? RADIO_HOST : RADIO_CLIENT);
+
+		while (1)
+		{
+			// host can answer only in acknowledgements, so give it something to acknowledge,
+			// right away while a ping is out so the answer doesn't wait for the next poll
+			if (SETTINGS.id != 0 && ((pingWaiting && millis() - timeSend < 1000) || millis() - lastPoll > WIRELESS_TEST_POLL))
+			{
+				sendTimeWireless(0);
+				lastPoll = millis();
+			}
+
+			// clear ping sent message if enough time has passed
+			if (removePingInfo && millis() - timeSend > 1000)
+			{
+				display.fillRect(0, 60, 128, 10, ST7735_BLACK);
+				removePingInfo = 0;
+			}
+
+			if (removePingInfo2 && millis() - timeAnyMsgReceived > 1000)
+			{
+				display.fillRect(0, 70, 128, 20, ST7735_BLACK);
+				removePingInfo2 = 0;
+			}
+
+			if (timeReceived != lastTimeReceived && timeSend != lastTimeSend)
+			{
+				display.fillRect(0, 110, 128, 10, ST7735_BLACK);
+				print(pingUs / 1000, 0, 110);
+				print(F("."));
+				print((pingUs / 100) % 10);
+				print(F(" ms"));
+
+				lastTimeReceived = timeReceived;
+				lastTimeSend = timeSend;
+			}
+
+			if (millis() - lastDisplayUpdate > 100)
 			{
-				/*
-					CHANGE ME IF MAKING CHANGES TO MAIN MENU
-				*/
-				display.fillScreen(0);
-				display.setCursor(0, 0);
+				if (timeReceived != 0)
+				{
+					print(F("Last ping sent "), 0, 130);
+					display.fillRect(0, 140, 128, 10, ST7735_BLACK);
+
+					unsigned long time = millis() - lastTimeReceived;
+					print(time / 1000, 0, 140);
+					print(F("."));
+					print((time / 100) % 10);
+					print(F(" s ago"));
+				}
 
-				if (menuSelector == 0) // buzzer
+				lastDisplayUpdate = millis();
+			}
+
+			// check if any data available, SPI is used only if the IRQ pin said so
+			radioLink.service();
+			unsigned long receivedData = 0;
+			if (radioLink.receive(&receivedData, sizeof(receivedData)) && receivedData != 0)
+			{
+				// if received same value as this that was send, this is a response to this device's ping
+				// if not, then we must answer as other device initiated the ping
+				if (receivedData == timeSend)
 				{
-					int valueToWrite = 1000;
-					int lastValue = -1;
-
-					print(F("Buzzer test"));
-					print(F("Hold OK to test"), 10, 30);
-					print(F("Frequency: "), 10, 40);
-
-					while (1)
-					{
-						if (valueToWrite != lastValue)
-						{
-							if (valueToWrite < 0)
-								valueToWrite = 0;
-							if (valueToWrite > 20000)
-								valueToWrite = 20000;
-
-							print(lastValue, 10, 50, ST7735_BLACK);
-							print(F(" hz"), -1, -1, ST7735_BLACK);
-
-							print(valueToWrite, 10, 50);
-							print(F(" hz"));
-
-							lastValue = valueToWrite;
-						}
-
-						if (button.up.state())
-							valueToWrite += 10;
-						if (button.down.state())
-							valueToWrite -= 10;
-						if (button.esc.state() == 1 || button.left.state() == 1)
-						{
-							noTone(BUZZER);
-							break;
-						}
-
-						if (button.ok.state() == 2)
-						{
-							tone(BUZZER, valueToWrite);
-						}
-						else
-						{
-							noTone(BUZZER);
-						}
-					}
+					print(F("Ping returned"), 0, 70, ST7735_CYAN);
+					timeReceived = millis();
+
+					// host's ping left only with the next packet of the other console
+					pingUs = radioLink.receivedTime() - (SETTINGS.id == 0 ? radioLink.sentTime() : pingSentAt);
+					pingWaiting = false;
 				}
-				else if (menuSelector == 1) // vibrator
+				else
 				{
+					print(F("Ping requested"), 0, 80, ST7735_BLUE);
+					sendTimeWireless(receivedData);
+				}
+
+				timeAnyMsgReceived = millis();
+				removePingInfo2 = 1;
+			}
+
+			if (button.esc.state() == 1 || button.left.state() == 1)
+			{
+				radioLink.endSession();
+				power.radioOff();
+				tasks.sleep(100);
+				break;
+			}
+
+			// can hold the button
+			if (button.ok.state() && millis() - timeSend > 200)
+				pingRequested = true;
+
+			// client can't send while a poll is in the air, then it goes on the next pass
+			if (pingRequested)
+			{
+				unsigned long now = millis();
+				if (sendTimeWireless(now))
+				{
+					pingRequested = false;
+					timeSend = now;
+					pingSentAt = radioLink.sentTime();
+					pingWaiting = true;
+					print(F("Ping sent..."), 0, 60, ST7735_YELLOW);
+					removePingInfo = true;
+				}
+			}
+
+			tasks.idle();
+		}
+	}
+	else if (test == 3) // buttons
+	{
+		// counts presses from the event queue, so none are missed even if drawing is slow
+		int presses[BUTTON_COUNT] = {0};
+		bool updateRequired = 1;
+		button.clear();
+
+		while (1)
+		{
+			ButtonEvent event;
+			if (button.read(event) && event.type == BUTTON_PRESS)
+			{
+				if (event.button == BUTTON_ESC)
+					break;
+
+				presses[event.button]++;
+				updateRequired = 1;
+			}
+
+			if (updateRequired)
+			{
+				display.fillScreen(COLOR_BLACK);
+				print(F("Ok: "), 0, 0, COLOR_WHITE);
+				print(presses[BUTTON_OK]);
+				print(F("\nMenu: "));
+				print(presses[BUTTON_MENU]);
+				print("\nUp: ");
+				print(presses[BUTTON_UP]);
+				print(F("\nRight: "));
+				print(presses[BUTTON_RIGHT]);
+				print(F("\nDown: "));
+				print(presses[BUTTON_DOWN]);
+				print(F("\nLeft: "));
+				print(presses[BUTTON_LEFT]);
+
+				updateRequired = 0;
+			}
+
+			tasks.idle();
+		}
+	}
+	else if (test == 4) // colors
+	{
+		// r = red, rl = redLast
+		int color[3] = {0}, colorLast[3] = {0};
+		bool updateRequired = 1;
+		byte innerMenu = getMenuSelector(0, 2);
+
+		while (1)
+		{
+			// check if display update required
+			for (int i = 0; i < 3; i++)
+			{
+				if (color[i] != colorLast[i])
+				{
+					updateRequired = 1;
+					break;
+				}
+			}
+
+			// update display
+			if (updateRequired)
+			{
+				display.fillRect(0, menuOptionY, 128, 30, COLOR_BLACK);
+				print(F("Red: "), 30, menuOptionY, COLOR_WHITE);
+				print(color[0]);
+				print(F("Green: "), 30, menuOptionY + 10);
+				print(color[1]);
+				print(F("Blue: "), 30, menuOptionY + 20);
+				print(color[2]);
+
+				unsigned int colorToPrint = getColor(color[0], color[1], color[2]);
+
+				display.fillRect(0, 0, 128, menuOptionY, colorToPrint);
+				display.fillRect(0, menuOptionY + 30, 128, 160 - 30 - menuOptionY, colorToPrint);
+
+				// save the color that is printed
+				for (int i = 0; i < 3; i++)
+				{
+					colorLast[i] = color[i];
+				}
+
+				updateRequired = 0;
+			}
+
+			// check buttons, up/down are handled by getMenuSelector
+			if (button.esc.state())
+				break;
+			if (button.left.state())
+			{
+				color[innerMenu]--;
+				if (color[innerMenu] < 0)
+					color[innerMenu] = 31;
+			}
+			if (button.right.state())
+			{
+				color[innerMenu]++;
+				if (color[innerMenu] > 31)
+					color[innerMenu] = 0;
+			}
+			innerMenu = getMenuSelector();
+
+			tasks.idle();
+		}
+	}
+	else if (test == 5) // colors
+	{
+		unsigned long lastUpdated = 0;
+		unsigned long updateTime = 100;
+		int r = 31, g = 0, b = 0, step = 0;
+		bool printHint = true, printHintLast = false;
 
-					int valueToWrite = 1000; // set to max
-					int lastValue = -1;
-					int writtenValue = -1;
-
-					print(F("Vibrator test"));
-					print(F("Hold OK to test"), 10, 30);
-					print(F("PWM value: "), 10, 40);
-
-					while (1)
-					{
-						if (valueToWrite != lastValue)
-						{
-							if (valueToWrite < 0)
-								valueToWrite = 0;
-							if (valueToWrite > 255)
-								valueToWrite = 255;
-
-							print(lastValue, 10, 50, ST77XX_BLACK);
-							print(F(" / 255"), -1, -1, ST77XX_BLACK);
-
-							print(valueToWrite, 10, 50);
-							print(F(" / 255"));
-
-							lastValue = valueToWrite;
-						}
-
-						if (button.up.state())
-							valueToWrite += 10;
-						if (button.down.state())
-							valueToWrite -= 10;
-						if (button.esc.state() == 1 || button.left.state() == 1)
-						{
-							digitalWrite(VIBR, LOW);
-							break;
-						}
-
-						if (button.ok.state() == 2)
-						{
-							if (writtenValue != valueToWrite)
-							{
-								analogWrite(VIBR, valueToWrite);
-								writtenValue = valueToWrite;
-							}
-						}
-						else
-						{
-							digitalWrite(VIBR, LOW);
-							writtenValue = 0;
-						}
-					}
+		while (1)
+		{
+			if (millis() - lastUpdated > updateTime)
+			{
+				// red -> red + blue
+				if (step == 0)
+				{
+					b++;
+					if (b >= 31)
+						step++;
+				}
+				// red + blue -> blue
+				else if (step == 1)
+				{
+					r--;
+					if (r <= 0)
+						step++;
 				}
-				else if (menuSelector == 2) // wireless
+				// blue -> blue + green
+				else if (step == 2)
 				{
-					print(F("Wireless test"));
-					print(F("This is radio #"), 0, 30);
-					print(SETTINGS.id);
-					print(F("Press OK to try to\ncommunicate"), 0, 40);
-					print(F("Received ping in"), 0, 100);
-					print(F("-"), 0, 110);
-
-					unsigned long timeSend = millis(); // randomize this number, so the display will update
-					unsigned long lastTimeSend = 0;
-					unsigned long timeReceived = 0;
-					unsigned long lastTimeReceived = timeSend; // again, so the display updates
-					unsigned long lastDisplayUpdate = 0;
-					unsigned long timeAnyMsgReceived = 0; // used for ping received message
-
-					bool removePingInfo = 0;
-					bool removePingInfo2 = 0;
-
-					radio.powerUp();
-					radio.startListening();
-
-					while (1)
-					{
-						// clear ping sent message if enough time has passed
-						if (removePingInfo && millis() - timeSend > 1000)
-						{
-							display.fillRect(0, 60, 128, 10, ST7735_BLACK);
-							removePingInfo = 0;
-						}
-
-						if (removePingInfo2 && millis() - timeAnyMsgReceived > 1000)
-						{
-							display.fillRect(0, 70, 128, 20, ST7735_BLACK);
-							removePingInfo2 = 0;
-						}
-
-						if (timeReceived != lastTimeReceived && timeSend != lastTimeSend)
-						{
-							display.fillRect(0, 110, 128, 10, ST7735_BLACK);
-							print(timeReceived - timeSend, 0, 110);
-							print(F(" ms"));
-
-							lastTimeReceived = timeReceived;
-							lastTimeSend = timeSend;
-						}
-
-						if (millis() - lastDisplayUpdate > 100)
-						{
-							if (timeReceived != 0)
-							{
-								print(F("Last ping sent "), 0, 130);
-								display.fillRect(0, 140, 128, 10, ST7735_BLACK);
-
-								unsigned long time = millis() - lastTimeReceived;
-								print(time / 1000, 0, 140);
-								print(F("."));
-								print((time / 100) % 10);
-								print(F(" s ago"));
-							}
-
-							lastDisplayUpdate = millis();
-						}
-
-						// check if any data available
-						uint8_t pipe;
-						if (radio.available(&pipe)) // is there a payload? get the pipe number that received it
-						{
-							uint8_t bytes = radio.getPayloadSize(); // get the size of the payload
-							unsigned long receivedData = 0;
-							radio.read(&receivedData, bytes); // fetch payload from FIFO
-
-							// if received same value as this that was send, this is a response to this device's ping
-							// if not, then we must answer as other device initiated the ping
-							if (receivedData == timeSend)
-							{
-								print(F("Ping returned"), 0, 70, ST7735_CYAN);
-								timeReceived = millis();
-							}
-							else
-							{
-								print(F("Ping requested"), 0, 80, ST7735_BLUE);
-								sendTimeWireless(receivedData);
-							}
-
-							timeAnyMsgReceived = millis();
-							removePingInfo2 = 1;
-						}
-
-						if (button.esc.state() == 1 || button.left.state() == 1)
-						{
-							radio.startListening();
-							radio.powerDown();
-							delay(100);
-							break;
-						}
-
-						// can hold the button
-						if (button.ok.state())
-						{
-							if (millis() - timeSend > 200)
-							{
-								timeSend = millis();
-								sendTimeWireless(timeSend);
-								print(F("Ping sent..."), 0, 60, ST7735_YELLOW);
-								removePingInfo = true;
-							}
-						}
-					}
+					g++;
+					if (g >= 31)
+						step++;
 				}
-				else if (menuSelector == 3) // buttons
+				// blue + green -> green
+				else if (step == 3)
 				{
-					int bOk = 0, bMenu = 0, bR = 0, bL = 0, bD = 0, bU = 0;
-					bool updateRequired = 1;
-
-					while (1)
-					{
-						if (button.esc.state())
-							break;
-						if (button.ok.state())
-						{
-							bOk++;
-							updateRequired = 1;
-						}
-						if (button.menu.state())
-						{
-							bMenu++;
-							updateRequired = 1;
-						}
-						if (button.up.state())
-						{
-							bU++;
-							updateRequired = 1;
-						}
-						if (button.right.state())
-						{
-							bR++;
-							updateRequired = 1;
-						}
-						if (button.down.state())
-						{
-							bD++;
-							updateRequired = 1;
-						}
-						if (button.left.state())
-						{
-							bL++;
-							updateRequired = 1;
-						}
-
-						if (updateRequired)
-						{
-							display.fillScreen(COLOR_BLACK);
-							print(F("Ok: "), 0, 0, COLOR_WHITE);
-							print(bOk);
-							print(F("\nMenu: "));
-							print(bMenu);
-							print("\nUp: ");
-							print(bU);
-							print(F("\nRight: "));
-							print(bR);
-							print(F("\nDown: "));
-							print(bD);
-							print(F("\nLeft: "));
-							print(bL);
-
-							updateRequired = 0;
-						}
-					}
+					b--;
+					if (b <= 0)
+						step++;
 				}
-				else if (menuSelector == 4) // colors
+				// green -> green + red
+				else if (step == 4)
 				{
-					// r = red, rl = redLast
-					int color[3] = {0}, colorLast[3] = {0};
-					bool updateRequired = 1;
-					byte innerMenu = getMenuSelector(0, 2);
-
-					while (1)
-					{
-						// check if display update required
-						for (int i = 0; i < 3; i++)
-						{
-							if (color[i] != colorLast[i])
-							{
-								updateRequired = 1;
-								break;
-							}
-						}
-
-						// update display
-						if (updateRequired)
-						{
-							display.fillRect(0, menuOptionY, 128, 30, COLOR_BLACK);
-							print(F("Red: "), 30, menuOptionY, COLOR_WHITE);
-							print(color[0]);
-							print(F("Green: "), 30, menuOptionY + 10);
-							print(color[1]);
-							print(F("Blue: "), 30, menuOptionY + 20);
-							print(color[2]);
-
-							unsigned int colorToPrint = getColor(color[0], color[1], color[2]);
-
-							display.fillRect(0, 0, 128, menuOptionY, colorToPrint);
-							display.fillRect(0, menuOptionY + 30, 128, 160 - 30 - menuOptionY, colorToPrint);
-
-							// save the color that is printed
-							for (int i = 0; i < 3; i++)
-							{
-								colorLast[i] = color[i];
-							}
-
-							updateRequired = 0;
-						}
-
-						// check buttons, up/down are handled by getMenuSelector
-						if (button.esc.state())
-							break;
-						if (button.left.state())
-						{
-							color[innerMenu]--;
-							if (color[innerMenu] < 0)
-								color[innerMenu] = 31;
-						}
-						if (button.right.state())
-						{
-							color[innerMenu]++;
-							if (color[innerMenu] > 31)
-								color[innerMenu] = 0;
-						}
-						innerMenu = getMenuSelector();
-					}
+					r++;
+					if (r >= 31)
+						step++;
 				}
-				else if (menuSelector == 5) // colors
+				// green + red -> red
+				else if (step == 5)
 				{
-					unsigned long lastUpdated = 0;
-					unsigned long updateTime = 100;
-					int r = 31, g = 0, b = 0, step = 0;
-					bool printHint = true, printHintLast = false;
-
-					while (1)
-					{
-						if (millis() - lastUpdated > updateTime)
-						{
-							// red -> red + blue
-							if (step == 0)
-							{
-								b++;
-								if (b >= 31)
-									step++;
-							}
-							// red + blue -> blue
-							else if (step == 1)
-							{
-								r--;
-								if (r <= 0)
-									step++;
-							}
-							// blue -> blue + green
-							else if (step == 2)
-							{
-								g++;
-								if (g >= 31)
-									step++;
-							}
-							// blue + green -> green
-							else if (step == 3)
-							{
-								b--;
-								if (b <= 0)
-									step++;
-							}
-							// green -> green + red
-							else if (step == 4)
-							{
-								r++;
-								if (r >= 31)
-									step++;
-							}
-							// green + red -> red
-							else if (step == 5)
-							{
-								g--;
-								if (g <= 0)
-									step = 0; // go back to start
-							}
-
-							unsigned int color = getColor(r, g, b);
-							if (!printHint)
-								display.fillScreen(color);
-							else
-							{
-								display.fillRect(0, 0, 128, 70, color);
-								display.fillRect(0, 90, 128, 70, color);
-							}
-
-							if (printHint != printHintLast)
-							{
-								print(F("Up/down change speed"), 0, 70, COLOR_WHITE);
-								print(F("Ok to hide this msg"), 0, 80, COLOR_WHITE);
-
-								printHintLast = true;
-							}
-
-							lastUpdated = millis();
-						}
-
-						if (button.up.state())
-							if (updateTime < 10000)
-								updateTime += 10;
-						if (button.down.state())
-							if (updateTime > 10)
-								updateTime -= 10;
-						if (button.esc.state() || button.left.state())
-							break;
-						if (button.ok.state() == 1)
-						{
-							display.fillRect(0, 70, 128, 20, COLOR_BLACK);
-							printHint = !printHint;
-							if (!printHint)
-								printHintLast = 0;
-						}
-					}
+					g--;
+					if (g <= 0)
+						step = 0; // go back to start
 				}
 
-				// set so this function resets after returning from whatever was picked by the user
+				unsigned int color = getColor(r, g, b);
+				if (!printHint)
+					display.fillScreen(color);
+				else
+				{
+					display.fillRect(0, 0, 128, 70, color);
+					display.fillRect(0, 90, 128, 70, color);
+				}
+
+				if (printHint != printHintLast)
+				{
+					print(F("Up/down change speed"), 0, 70, COLOR_WHITE);
+					print(F("Ok to hide this msg"), 0, 80, COLOR_WHITE);
+
+					printHintLast = true;
+				}
+
+				lastUpdated = millis();
+			}
+
+			if (button.up.state())
+				if (updateTime < 10000)
+					updateTime += 10;
+			if (button.down.state())
+				if (updateTime > 10)
+					updateTime -= 10;
+			if (button.esc.state() || button.left.state())
 				break;
+			if (button.ok.state() == 1)
+			{
+				display.fillRect(0, 70, 128, 20, COLOR_BLACK);
+				printHint = !printHint;
+				if (!printHint)
+					printHintLast = 0;
 			}
 
+			tasks.idle();
+		}
+	}
+
+	else if (test == 6) // link stats
+	{
+		drawLinkStats();
+
+		while (1)
+		{
 			if (button.esc.state() == 1 || button.left.state() == 1)
-				return;
+				break;
+
+			if (button.ok.state() == 1)
+			{
+				// TX only, D0 is the radio IRQ pin
+				Serial.begin(LINK_STATS_BAUD);
+				UCSR0B &= ~_BV(RXEN0);
+				linkStats.print(Serial);
+				Serial.flush();
+				Serial.end();
+
+				display.fillRect(0, 152, 128, 8, COLOR_BLACK);
+				print(F("Sent to Serial"), 0, 152, COLOR_GREEN);
+			}
+
+			if (button.menu.state() == 1)
+			{
+				linkStats.reset();
+				drawLinkStats();
+			}
+
+			tasks.idle();
+		}
+	}
+	else if (test == 7) // power
+	{
+		unsigned long lcdUpdate = 0;
+
+		print(F("Power"), 0, 0, COLOR_RED | COLOR_GREEN);
+		print(F("Since the last reset"), 0, 20);
+		print(F("MENU-reset"), 0, 152, COLOR_BLUE | COLOR_GREEN);
+
+		while (1)
+		{
+			if (millis() - lcdUpdate > 1000)
+			{
+				display.fillRect(0, 40, 128, 20, COLOR_BLACK);
+				print(F("CPU awake "), 0, 40);
+				print(power.awakePercent());
+				print(F("%"));
+				print(F("Radio on "), 0, 50);
+				print(power.radioPercent());
+				print(F("%"));
+
+				lcdUpdate = millis();
+			}
+
+			if (button.esc.state() == 1 || button.left.state() == 1)
+				break;
+
+			if (button.menu.state() == 1)
+			{
+				power.resetStats();
+				lcdUpdate = 0;
+			}
+
+			tasks.idle();
 		}
 	}
 }
@@ -818,84 +1084,25 @@ void infoMenu()
 
 		if (millis() - lcdUpdate > 1000)
 		{
-			display.fillRect(15, 125, 128 - 15, 10, COLOR_BLACK);
-			print(F("Battery: "), 15, 125);
-			print(analogRead(BATTERY) * 5.0 / 1024.0);
-			print(F(" V"));
+			display.fillRect(4, 125, 128 - 4, 10, COLOR_BLACK);
+			print(F("Battery: "), 4, 125);
+			print(battery.millivolts() / 1000.0);
+			print(F(" V "));
+			print(battery.percent());
+			print(F("%"));
 
 			lcdUpdate = millis();
 		}
 
+		if (battery.lowEvent())
+			drawInfoPanel();
+
 		// escape
 		if (button.left.state() == 1 || button.esc.state() == 1)
 		{
 			return;
 		}
-	}
-}
-
-void optionsMenu()
-{
-	byte menuSelector = 0;
-
-	while (1)
-	{
-		drawMenu(menuOptions);
-
-		// draw vibration settings
-		printOnOff(SETTINGS.vibrations, menuOptionY);
-		// draw sound settings
-		printOnOff(SETTINGS.sound, menuOptionY + menuOptionHeight);
-
-		menuSelector = getMenuSelector(menuSelector, sizeof(menuOptions) / sizeof(char *) - 2);
-
-		while (true)
-		{
-			menuSelector = getMenuSelector();
 
-			// launch
-			if (button.ok.state() == 1 || button.right.state() == 1)
-			{
-				if (menuSelector == 0) // vibr
-				{
-					SETTINGS.vibrations = !SETTINGS.vibrations;
-				}
-				else if (menuSelector == 1) // sound
-				{
-					SETTINGS.sound = !SETTINGS.sound;
-				}
-				else if (menuSelector == 2) // save
-				{
-					saveSettings();
-				}
-				else if (menuSelector == 3 || menuSelector == 4) // set id
-				{
-					SETTINGS.id = menuSelector - 3;
-					saveSettings();
-
-					display.fillScreen(COLOR_BLACK);
-					print(F("ID of this console"), 0, 0, COLOR_WHITE);
-					print(F("is set to "), 0, 10);
-					print(SETTINGS.id);
-					print(F("Restart required."), 0, 50, COLOR_RED | COLOR_GREEN);
-					print(F("Turn the console OFF"), 0, 60, COLOR_RED);
-
-					while (1)
-						digitalWrite(VIBR, 0);
-				}
-				else if (menuSelector == 5) // reset default
-				{
-					defaultSettings();
-				}
-
-				break;
-			}
-
-			// escape
-			if (button.left.state() == 1 || button.esc.state() == 1)
-			{
-				return;
-			}
-		}
+		tasks.idle();
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,443 @@
+#pragma once
+#include "FixedPoint.h"
+
+/*
+	Wire format of the multiplayer game state.
+
+	Instead of sending the whole state as a struct every time, the state is
+	quantized and bit-packed, and only the fields that changed since the last
+	packet the other console decoded are sent. A typical packet during the
+	game is 6-8 bytes, a full one (keyframe) is 11.
+
+	Packet layout (bits are packed starting from the lowest bit of each byte):
+		byte 0  - bits 0-2 version, bit 3 keyframe, bits 4-7 which fields follow
+		byte 1  - sequence number, never 0
+		byte 2  - sequence number of the last packet decoded from the other console (0 - none yet)
+		byte 3  - sequence number of the base state (only if not a keyframe)
+		fields, in this order, only those present:
+			NET_FIELD_BALL_POS   ball x 10 bits, ball y 11 bits, both in 1/8 px
+			NET_FIELD_BALL_VEL   ball velX 12 bits, velY 12 bits, signed, raw Fixed
+			NET_FIELD_PLATFORM   platform x 7 bits
+			NET_FIELD_STATE      score 7 bits, flags 3 bits
+
+	Delta encoding:
+		The sender keeps the last few states it sent. When a packet of the
+		other console says which one it decoded, that state becomes the base,
+		and only the fields that differ from it are sent, together with its
+		sequence number. A radio acknowledgement is not enough: with ACK
+		payloads the host's packet can get lost on the way back while the
+		client's packet arrived. If a confirmation is late the receiver is
+		ahead of the sender, so it keeps the last few received states and
+		decodes against the one the packet names. Every NET_KEYFRAME_INTERVAL
+		packets the full state is sent anyway, so the two sides can never
+		stay out of sync.
+
+	Radio has to have dynamic payloads enabled.
+*/
+#define NET_VERSION 1
+#define NET_PACKET_MAX 12 // longest packet, a keyframe is 11 bytes
+#define NET_KEYFRAME_INTERVAL 16
+#define NET_HISTORY 4 // how many sent states the encoder and received states the decoder keep
+
+#define NET_FIELD_BALL_POS 0x01
+#define NET_FIELD_BALL_VEL 0x02
+#define NET_FIELD_PLATFORM 0x04
+#define NET_FIELD_STATE 0x08
+#define NET_FIELD_ALL 0x0F
+
+#define NET_FLAG_QUIT 0x01 // player left the game
+
+// quantization
+#define NET_POS_SHIFT (FIXED_FRACTION_BITS - 3) // positions are sent in 1/8 px
+#define NET_POS_X_BITS 10
+#define NET_POS_Y_BITS 11
+#define NET_VEL_BITS 12
+#define NET_PLATFORM_BITS 7
+#define NET_SCORE_BITS 7
+#define NET_FLAGS_BITS 3
+
+/*
+	Game state as seen by the game.
+*/
+struct NetState
+{
+	Fixed ballPosX, ballPosY, ballVelX, ballVelY;
+	byte platformPosX;
+	byte score;
+	byte flags;
+};
+
+/*
+	Writes values of any width (up to 16 bits) one after another.
+*/
+class BitWriter
+{
+private:
+	byte *out;
+	byte bits = 0;
+
+public:
+	BitWriter(byte *out) : out(out) {}
+
+	void write(uint16_t value, byte width)
+	{
+		while (width--)
+		{
+			if ((bits & 7) == 0)
+				out[bits >> 3] = 0;
+			if (value & 1)
+				out[bits >> 3] |= 1 << (bits & 7);
+
+			value >>= 1;
+			bits++;
+		}
+	}
+
+	// number of bytes used so far
+	byte length() const
+	{
+		return (bits + 7) >> 3;
+	}
+};
+
+class BitReader
+{
+private:
+	const byte *in;
+	byte size;
+	byte bits = 0;
+	bool overrun = false;
+
+public:
+	BitReader(const byte *in, byte size) : in(in), size(size) {}
+
+	uint16_t read(byte width)
+	{
+		uint16_t value = 0;
+
+		for (byte i = 0; i < width; i++, bits++)
+		{
+			if ((bits >> 3) >= size)
+			{
+				overrun = true;
+				return 0;
+			}
+			if (in[bits >> 3] & (1 << (bits & 7)))
+				value |= 1 << i;
+		}
+
+		return value;
+	}
+
+	int16_t readSigned(byte width)
+	{
+		uint16_t value = read(width);
+
+		// sign extend
+		if (value & (1 << (width - 1)))
+			value |= 0xFFFF << width;
+
+		return value;
+	}
+
+	// false if the packet was shorter than what was read from it
+	bool ok() const
+	{
+		return !overrun;
+	}
+};
+
+/*
+	NetState after quantization, this is what is compared when looking for
+	changed fields and what both sides keep as the base state.
+*/
+struct NetFields
+{
+	uint16_t posX, posY;
+	int16_t velX, velY;
+	byte platform, score, flags;
+
+	NetFields()
+	{
+	}
+	NetFields(const NetState &s)
+	{
+		posX = quantizePos(s.ballPosX, NET_POS_X_BITS);
+		posY = quantizePos(s.ballPosY, NET_POS_Y_BITS);
+		velX = clampVel(s.ballVelX.toRaw());
+		velY = clampVel(s.ballVelY.toRaw());
+		platform = s.platformPosX & ((1 << NET_PLATFORM_BITS) - 1);
+		score = s.score & ((1 << NET_SCORE_BITS) - 1);
+		flags = s.flags & ((1 << NET_FLAGS_BITS) - 1);
+	}
+
+	NetState toState() const
+	{
+		NetState s;
+		s.ballPosX = Fixed::fromRaw(posX << NET_POS_SHIFT);
+		s.ballPosY = Fixed::fromRaw(posY << NET_POS_SHIFT);
+		s.ballVelX = Fixed::fromRaw(velX);
+		s.ballVelY = Fixed::fromRaw(velY);
+		s.platformPosX = platform;
+		s.score = score;
+		s.flags = flags;
+		return s;
+	}
+
+	/*
+		Returns NET_FIELD_ bits of fields that are different.
+	*/
+	byte changed(const NetFields &other) const
+	{
+		byte fields = 0;
+
+		if (posX != other.posX || posY != other.posY)
+			fields |= NET_FIELD_BALL_POS;
+		if (velX != other.velX || velY != other.velY)
+			fields |= NET_FIELD_BALL_VEL;
+		if (platform != other.platform)
+			fields |= NET_FIELD_PLATFORM;
+		if (score != other.score || flags != other.flags)
+			fields |= NET_FIELD_STATE;
+
+		return fields;
+	}
+
+	void write(BitWriter &w, byte fields) const
+	{
+		if (fields & NET_FIELD_BALL_POS)
+		{
+			w.write(posX, NET_POS_X_BITS);
+			w.write(posY, NET_POS_Y_BITS);
+		}
+		if (fields & NET_FIELD_BALL_VEL)
+		{
+			w.write(velX, NET_VEL_BITS);
+			w.write(velY, NET_VEL_BITS);
+		}
+		if (fields & NET_FIELD_PLATFORM)
+			w.write(platform, NET_PLATFORM_BITS);
+		if (fields & NET_FIELD_STATE)
+		{
+			w.write(score, NET_SCORE_BITS);
+			w.write(flags, NET_FLAGS_BITS);
+		}
+	}
+
+	// overwrites only the fields that are in the packet
+	void read(BitReader &r, byte fields)
+	{
+		if (fields & NET_FIELD_BALL_POS)
+		{
+			posX = r.read(NET_POS_X_BITS);
+			posY = r.read(NET_POS_Y_BITS);
+		}
+		if (fields & NET_FIELD_BALL_VEL)
+		{
+			velX = r.readSigned(NET_VEL_BITS);
+			velY = r.readSigned(NET_VEL_BITS);
+		}
+		if (fields & NET_FIELD_PLATFORM)
+			platform = r.read(NET_PLATFORM_BITS);
+		if (fields & NET_FIELD_STATE)
+		{
+			score = r.read(NET_SCORE_BITS);
+			flags = r.read(NET_FLAGS_BITS);
+		}
+	}
+
+private:
+	static uint16_t quantizePos(Fixed pos, byte width)
+	{
+		int16_t q = pos.toRaw() >> NET_POS_SHIFT;
+		if (q < 0)
+			return 0;
+		if (q >= (1 << width))
+			return (1 << width) - 1;
+		return q;
+	}
+
+	static int16_t clampVel(int16_t raw)
+	{
+		const int16_t limit = (1 << (NET_VEL_BITS - 1)) - 1;
+		if (raw > limit)
+			return limit;
+		if (raw < -limit)
+			return -limit;
+		return raw;
+	}
+};
+
+/*
+	Sending side. Usage:
+		byte packet[NET_PACKET_MAX];
+		byte length = encoder.encode(state, decoder.sequence(), packet);
+		radio.write(packet, length);
+		...
+		if (decoder.decode(in, inLength, other))
+			encoder.acknowledged(decoder.acknowledgedSequence());
+*/
+class NetEncoder
+{
+private:
+	NetFields acked;
+	NetFields sent[NET_HISTORY];
+	byte sentSeq[NET_HISTORY] = {0};
+	byte sentNext = 0;
+	byte seq = 0;
+	byte ackedSeq = 0;
+	bool hasAcked = false;
+	byte sinceKeyframe = 0;
+
+public:
+	/*
+		Writes the packet for the given state to out (at least NET_PACKET_MAX
+		bytes) and returns its length. received is the sequence number of the
+		last packet decoded from the other console.
+	*/
+	byte encode(const NetState &state, byte received, byte *out)
+	{
+		NetFields pending = NetFields(state);
+
+		// 0 is left for "nothing decoded yet"
+		if (++seq == 0)
+			seq = 1;
+
+		bool keyframe = !hasAcked || sinceKeyframe >= NET_KEYFRAME_INTERVAL;
+		byte fields = keyframe ? NET_FIELD_ALL : pending.changed(acked);
+
+		if (keyframe)
+			sinceKeyframe = 0;
+		else
+			sinceKeyframe++;
+
+		BitWriter w(out);
+		w.write(NET_VERSION | (keyframe << 3) | (fields << 4), 8);
+		w.write(seq, 8);
+		w.write(received, 8);
+		if (!keyframe)
+			w.write(ackedSeq, 8);
+		pending.write(w, fields);
+
+		sent[sentNext] = pending;
+		sentSeq[sentNext] = seq;
+		sentNext = (sentNext + 1) % NET_HISTORY;
+
+		return w.length();
+	}
+
+	/*
+		The other console decoded the packet with this sequence number, its
+		state is the base of the next packets. Older confirmations than the
+		current base, and ones of states no longer kept, are ignored.
+	*/
+	void acknowledged(byte seq)
+	{
+		if (seq == 0 || (hasAcked && (int8_t)(seq - ackedSeq) <= 0))
+			return;
+
+		for (byte i = 0; i < NET_HISTORY; i++)
+		{
+			if (sentSeq[i] == seq)
+			{
+				acked = sent[i];
+				ackedSeq = seq;
+				hasAcked = true;
+				return;
+			}
+		}
+	}
+
+	byte sequence() const
+	{
+		return seq;
+	}
+};
+
+/*
+	Receiving side.
+*/
+class NetDecoder
+{
+private:
+	NetFields history[NET_HISTORY];
+	byte historySeq[NET_HISTORY];
+	byte historyValid = 0; // bit per history slot
+	byte historyNext = 0;
+	byte lastSeq = 0;
+	byte lastAck = 0;
+
+public:
+	/*
+		Returns false if the packet is not a valid game packet or if its base
+		state is not known (it will be resent as a keyframe soon).
+	*/
+	bool decode(const byte *in, byte length, NetState &out)
+	{
+		if (length < 3)
+			return false;
+
+		BitReader r(in, length);
+		byte header = r.read(8);
+		byte seq = r.read(8);
+		byte ack = r.read(8);
+		bool keyframe = header & 0x08;
+		byte fields = header >> 4;
+
+		if ((header & 0x07) != NET_VERSION)
+			return false;
+
+		// what the other console decoded is known even if this packet can't be
+		lastAck = ack;
+
+		NetFields state;
+		if (!keyframe)
+		{
+			byte base = r.read(8);
+			byte slot = find(base);
+			if (slot == NET_HISTORY)
+				return false;
+			state = history[slot];
+		}
+		else if (fields != NET_FIELD_ALL)
+		{
+			return false;
+		}
+
+		state.read(r, fields);
+		if (!r.ok())
+			return false;
+
+		history[historyNext] = state;
+		historySeq[historyNext] = seq;
+		historyValid |= 1 << historyNext;
+		historyNext = (historyNext + 1) % NET_HISTORY;
+		lastSeq = seq;
+
+		out = state.toState();
+		return true;
+	}
+
+	// sequence number of the last decoded packet
+	byte sequence() const
+	{
+		return lastSeq;
+	}
+
+	// sequence number of this console's packet the other one decoded last, 0 - none yet
+	byte acknowledgedSequence() const
+	{
+		return lastAck;
+	}
+
+private:
+	byte find(byte seq) const
+	{
+		for (byte i = 0; i < NET_HISTORY; i++)
+		{
+			if ((historyValid & (1 << i)) && historySeq[i] == seq)
+				return i;
+		}
+		return NET_HISTORY;
+	}
+};
@@ -2,42 +2,108 @@
 #include <SPI.h>
 #include <Adafruit_ST7735.h> // https://github.com/adafruit/Adafruit-ST7735-Library library for ST7735
 #include <RF24.h>			 // https://github.com/nRF24/RF24 - RF24 by TMRh20
+#include "BandRenderer.h"
 #include "ButtonEvent.h"
+#include "FixedPoint.h"
+#include "FrameScheduler.h"
+#include "Game.h"
+#include "Haptics.h"
+#include "Lockstep.h"
 #include "MainMenu.h"
+#include "NetPacket.h"
+#include "Power.h"
+#include "Profiler.h"
+#include "RadioLink.h"
+#include "Renderer.h"
+#include "SendRate.h"
 #include "Settings.h"
+#include "Sound.h"
+#include "Tasks.h"
 
 // all objects defined in main .ino file that will also be used here
 extern Adafruit_ST7735 display;
 extern RF24 radio;
-extern void vibrate(unsigned long = __LONG_MAX__, byte = 255);
-extern void toneHelper(unsigned int freq, unsigned int duration);
 
 #define BALL_RADIUS 2
 #define BALL_STARTING_VEL_X 1.5
 #define BALL_STARTING_VEL_Y 1.5
 #define BALL_INCREASE_V_PER_BOUNCE 0.07 // every time ball hits vertical wall its velX and velY will increase by this amount
 
+/*
+	Ball position and velocity are Fixed (see FixedPoint.h), the values above
+	are converted with FIXED() where they are used.
+*/
+
 #define SHOW_POINTS_TIMEOUT 1500 // how long to show score after some player scored
 #define FIELD_WALL_THICKNESS 1
 #define PLAYER_THICKNESS 1
 
-#define VIBRATE_WALL_HIT 20
-#define VIBRATE_POINT_LOST 300
-
-#define TONE_WALL_HIT_FREQ 200
-#define TONE_WALL_HIT_DUR 50
-
 #define PLAYER_POINTS_MAX 100
 
+// buttons of one player, as sent in the lockstep mode
+#define PLATFORM_LEFT 0x01
+#define PLATFORM_RIGHT 0x02
+
+/*
+	Multiplayer smoothing. Packets come only every ~100 ms, so between them
+	the other platform is moved with the speed it had, and corrections of the
+	ball are spread over a few frames instead of jumping.
+*/
+#define REMOTE_PLATFORM_SPEED 3	 // max px per step the other platform is moved on screen
+#define REMOTE_PREDICT_STEPS 8	 // stop guessing the other platform's movement after this many steps without a packet
+#define BALL_CORRECTION_SNAP 24	 // ball corrections longer than this (px) are not smoothed
+#define BALL_CORRECTION_SHIFT 2	 // every step 1/4 of the remaining correction is applied
+
+#define PONG_STEP_US 25000   // length of one physics step in us, ball velocity is in pixels per step
+#define PONG_RENDER_US 25000 // time between two frames in us, can be longer than the step
+
+/*
+	Multiplayer handshake. The joining console sends a hello every
+	PONG_HELLO_INTERVAL, the host answers a hello of its own mode with the
+	same packet as an ACK payload, so it goes back with the next hello.
+	The host starts when that next hello comes, the joining console when
+	the answer comes. Consoles in different modes never start.
+
+	Hello is one byte, version in bits 0-2 like NetPacket.h and Lockstep.h,
+	so it can't be mistaken for a game packet, bit 3 set for lockstep.
+*/
+#define PONG_HELLO_VERSION 3
+#define PONG_HELLO_LOCKSTEP 0x08
+#define PONG_HELLO_INTERVAL 100 // ms
+
 const char _menu_0[] PROGMEM = "Pong";
 const char _menu_1[] PROGMEM = "Single easy";
 const char _menu_2[] PROGMEM = "Host multi";
 const char _menu_3[] PROGMEM = "Join multi";
 const char _menu_4[] PROGMEM = "Training";
-const char *const menuMainPong[] PROGMEM = {_menu_0, _menu_1, _menu_2, _menu_3, _menu_4};
+const char _menu_5[] PROGMEM = "Lockstep multi";
+
+// actions of the game's menu, see MenuEngine in MainMenu.h
+#define PONG_SINGLE 0
+#define PONG_MULTI 1
+#define PONG_TRAINING 2
+#define PONG_LOCKSTEP 3
+
+// host and joining console differ only in the name of the multiplayer row
+const MenuItem menuPongHostItems[] PROGMEM = {
+	{_menu_1, MENU_ACTION, NULL, PONG_SINGLE},
+	{_menu_2, MENU_ACTION, NULL, PONG_MULTI},
+	{_menu_4, MENU_ACTION, NULL, PONG_TRAINING},
+	{_menu_5, MENU_ACTION, NULL, PONG_LOCKSTEP},
+};
+const MenuItem menuPongJoinItems[] PROGMEM = {
+	{_menu_1, MENU_ACTION, NULL, PONG_SINGLE},
+	{_menu_3, MENU_ACTION, NULL, PONG_MULTI},
+	{_menu_4, MENU_ACTION, NULL, PONG_TRAINING},
+	{_menu_5, MENU_ACTION, NULL, PONG_LOCKSTEP},
+};
+const Menu menuPongHost PROGMEM = {_menu_0, MENU_ITEMS(menuPongHostItems)};
+const Menu menuPongJoin PROGMEM = {_menu_0, MENU_ITEMS(menuPongJoinItems)};
 
-class Pong
+class Pong : public Game
 {
+	friend class PongBench; // host benchmark, see Simulator/Bench.cpp
+
 private:
 	class Platform;
 	class Ball;
@@ -49,38 +115,27 @@ private:
 		display.drawRect(0, 0, 128, 160, color);
 	}
 
-	/*
-		This struct will be send over the radio in the multiplayer game.
-	*/
-	struct GameData
+	struct Ball
 	{
-		double ballPosX, ballPosY, ballVelX, ballVelY;
-		byte platformPosX;
-		byte score;
-
-		GameData()
-		{
-		}
-		GameData(const Platform &pl, const Ball &b)
-		{
-			this->ballPosX = b.posX;
-			this->ballPosY = b.posY;
-			this->ballVelX = b.velX;
-			this->ballVelY = b.velY;
+		Fixed posX, posY, velX, velY;
 
-			this->platformPosX = pl.posX;
-			this->score = pl.points;
-		}
-	};
+		// what is left of the last correction from the other console, added only when drawing
+		Fixed errorX = 0, errorY = 0;
 
-	struct Ball
-	{
-		double posX, posY, velX, velY;
+		// where the ball is on the screen, see render()
+		int16_t drawnX, drawnY;
+		bool drawn = false;
 
 		Ball()
 		{
 		}
-		Ball(double posX, double posY, double velX, double velY)
+		Ball(Fixed posX, Fixed posY, Fixed velX, Fixed velY)
+		{
+			set(posX, posY, velX, velY);
+		}
+
+		// moves the ball, it will be redrawn on next render()
+		void set(Fixed posX, Fixed posY, Fixed velX, Fixed velY)
 		{
 			this->posX = posX;
 			this->posY = posY;
@@ -88,22 +143,53 @@ private:
 			this->velY = velY;
 		}
 
+		/*
+			Takes the state from the other console. The physics continues from it
+			right away, but on the screen the ball moves there over a few frames.
+		*/
+		void reconcile(Fixed posX, Fixed posY, Fixed velX, Fixed velY)
+		{
+			errorX += this->posX - posX;
+			errorY += this->posY - posY;
+
+			if (abs(errorX.toInt()) > BALL_CORRECTION_SNAP || abs(errorY.toInt()) > BALL_CORRECTION_SNAP)
+			{
+				errorX = 0;
+				errorY = 0;
+			}
+
+			set(posX, posY, velX, velY);
+		}
+
 		// resets the ball position
-		void reset(double velY)
+		void reset(Fixed velY)
 		{
-			draw(COLOR_BLACK);
 			this->posX = 128 / 2 - BALL_RADIUS / 2;
 			this->posY = 160 / 2 - BALL_RADIUS / 2;
 			this->velX = 0;
 			this->velY = velY;
+			errorX = 0;
+			errorY = 0;
 		}
 
-		void incSpeedHelper(double &speed)
+		// makes the correction smaller, called every step
+		static void decayError(Fixed &error)
+		{
+			int16_t raw = error.toRaw();
+			int16_t step = raw >> BALL_CORRECTION_SHIFT;
+
+			// shifting negative numbers never reaches 0, last bits go at once
+			if (step == 0 || step == -1)
+				step = raw;
+			error = Fixed::fromRaw(raw - step);
+		}
+
+		void incSpeedHelper(Fixed &speed)
 		{
 			if (speed < 0)
-				speed -= BALL_INCREASE_V_PER_BOUNCE;
+				speed -= FIXED(BALL_INCREASE_V_PER_BOUNCE);
 			else
-				speed += BALL_INCREASE_V_PER_BOUNCE;
+				speed += FIXED(BALL_INCREASE_V_PER_BOUNCE);
 		}
 
 		void incSpeed()
@@ -120,37 +206,35 @@ private:
 			if (posX - BALL_RADIUS <= FIELD_WALL_THICKNESS + 1)
 			{
 				velX = abs(velX);
-				vibrate(VIBRATE_WALL_HIT);
-				toneHelper(TONE_WALL_HIT_FREQ, TONE_WALL_HIT_DUR);
+				haptics.play(hapticWallHit);
+				sound.play(soundWallHit);
 				incSpeed();
 			}
 			else if (posX + BALL_RADIUS >= 127 - FIELD_WALL_THICKNESS)
 			{
-				velX = abs(velX) * -1.0;
-				vibrate(VIBRATE_WALL_HIT);
-				toneHelper(TONE_WALL_HIT_FREQ, TONE_WALL_HIT_DUR);
+				velX = -abs(velX);
+				haptics.play(hapticWallHit);
+				sound.play(soundWallHit);
 				incSpeed();
 			}
 		}
 
 		void update()
 		{
-			// draw black to erase the ball from the screen, after updates it will be drawn in some color
-			draw(COLOR_BLACK);
-
 			checkVerticalColl();
 
 			// update the position
 			posX += velX;
 			posY += velY;
 
+			decayError(errorX);
+			decayError(errorY);
+
 			// make sure ball isn't off-screen / doesn't touch vertical walls
 			if (posX > 128 - BALL_RADIUS - FIELD_WALL_THICKNESS)
 				posX = 128 - BALL_RADIUS;
 			if (posX < 0 + BALL_RADIUS + FIELD_WALL_THICKNESS)
 				posX = BALL_RADIUS + FIELD_WALL_THICKNESS;
-
-			draw(COLOR_WHITE);
 		}
 
 		/*
@@ -158,17 +242,16 @@ private:
 		*/
 		void updateFromButtons()
 		{
-			draw(COLOR_BLACK);
 			if (button.up.state())
-				posY--;
+				posY -= 1;
 			if (button.down.state())
-				posY++;
+				posY += 1;
 			if (button.left.state())
-				posX--;
+				posX -= 1;
 			if (button.right.state())
-				posX++;
+				posX += 1;
 			checkVerticalColl();
-			draw(COLOR_WHITE);
+			render();
 		}
 
 		/*
@@ -180,12 +263,12 @@ private:
 		*/
 		void bounce(const Platform &player)
 		{
-			vibrate(VIBRATE_WALL_HIT);
-			toneHelper(TONE_WALL_HIT_FREQ, TONE_WALL_HIT_DUR);
+			haptics.play(hapticWallHit);
+			sound.play(soundPlatformHit);
 
 			if (posY > 80)
 			{
-				velY = abs(velY) * -1.0;
+				velY = -abs(velY);
 			}
 			else
 			{
@@ -197,11 +280,11 @@ private:
 			{
 				if (player.posX + player.width / 2 > (128 - FIELD_WALL_THICKNESS * 2) / 2)
 				{
-					velX = -(BALL_STARTING_VEL_X)-0.5;
+					velX = FIXED(-(BALL_STARTING_VEL_X)-0.5);
 				}
 				else
 				{
-					velX = BALL_STARTING_VEL_X + 0.5;
+					velX = FIXED(BALL_STARTING_VEL_X + 0.5);
 				}
 
 				velY *= 2;
@@ -224,14 +307,14 @@ private:
 				*/
 				else if (posX + BALL_RADIUS >= player.posX && posX - BALL_RADIUS <= player.posX + player.width)
 				{
-					double velModifier = 0.25;
+					Fixed velModifier = FIXED(0.25);
 					if (velX < 0)
 						velModifier = -velModifier;
 
 					// if posX of the ball is smaller than middle of the platform - we are on leading corner
 					if (posX < player.posX + player.width / 2)
 					{
-						if (velX >= 1.5)
+						if (velX >= FIXED(1.5))
 						{
 							velX -= velModifier;
 							velY += abs(velModifier);
@@ -239,7 +322,7 @@ private:
 					}
 					else
 					{
-						if (velY >= 1.5)
+						if (velY >= FIXED(1.5))
 						{
 							velY -= abs(velModifier);
 							velX += velModifier;
@@ -261,9 +344,56 @@ private:
 			return true;
 		}
 
-		void draw(unsigned int color)
+		/*
+			Draws the ball at its current position, only the pixels that changed
+			since it was drawn last time are sent to the display.
+			If mirror is true the field is drawn upside down.
+		*/
+		void render(bool mirror = false)
+		{
+			int16_t x, y;
+			screenPosition(mirror, x, y);
+
+			if (drawn && x == drawnX && y == drawnY)
+				return;
+
+			renderer.moveCircle(BALL_RADIUS, drawnX, drawnY, drawn, x, y, COLOR_WHITE);
+			drawnX = x;
+			drawnY = y;
+			drawn = true;
+		}
+
+#if RENDER_BANDS
+		// puts the ball on the band renderer's list, see BandRenderer.h
+		void compose(bool mirror = false)
+		{
+			screenPosition(mirror, drawnX, drawnY);
+			bandRenderer.circle(drawnX, drawnY, BALL_RADIUS);
+			drawn = true;
+		}
+#endif
+
+		// where the ball is drawn, with the multiplayer correction
+		void screenPosition(bool mirror, int16_t &x, int16_t &y)
+		{
+			x = (posX + errorX).toInt();
+			y = (posY + errorY).toInt();
+
+			if (mirror)
+			{
+				x = 127 - x;
+				y = 159 - y;
+			}
+		}
+
+		/*
+			Draws the ball again where it is on the screen,
+			call if something else was drawn over it.
+		*/
+		void redraw()
 		{
-			display.drawCircle(posX, posY, BALL_RADIUS, color);
+			if (drawn)
+				display.drawCircle(drawnX, drawnY, BALL_RADIUS, COLOR_WHITE);
 		}
 	};
 
@@ -272,6 +402,10 @@ private:
 		byte posX, posY, width;
 		unsigned int points = PLAYER_POINTS_MAX;
 
+		// where the platform is on the screen, see render()
+		byte drawnX;
+		bool drawn = false;
+
 		Platform()
 		{
 		}
@@ -282,33 +416,85 @@ private:
 			this->width = width;
 		}
 
-		void draw(unsigned int color)
+		/*
+			Draws the platform at its current position. Only the columns that changed
+			are sent, plus anything the ball erased from it this frame.
+			If mirror is true the field is drawn upside down.
+		*/
+		void render(bool mirror = false)
 		{
-			display.fillRect(posX, posY, width, PLAYER_THICKNESS, color);
+			byte x = mirror ? 128 - posX - width : posX;
+			byte y = mirror ? 160 - PLAYER_THICKNESS - posY : posY;
+
+			if (!drawn)
+			{
+				display.fillRect(x, y, width, PLAYER_THICKNESS, COLOR_WHITE);
+			}
+			else
+			{
+				renderer.repair(drawnX, y, width, PLAYER_THICKNESS, COLOR_WHITE);
+
+				for (byte row = 0; row < PLAYER_THICKNESS; row++)
+					renderer.moveHLine(y + row, drawnX, x, width, COLOR_WHITE);
+			}
+
+			drawnX = x;
+			drawn = true;
+		}
+
+#if RENDER_BANDS
+		// puts the platform on the band renderer's list, see BandRenderer.h
+		void compose(bool mirror = false)
+		{
+			byte x = mirror ? 128 - posX - width : posX;
+			byte y = mirror ? 160 - PLAYER_THICKNESS - posY : posY;
+			bandRenderer.rect(x, y, width, PLAYER_THICKNESS);
+		}
+#endif
+
+		/*
+			Returns PLATFORM_LEFT / PLATFORM_RIGHT bits of the buttons pressed
+			in the last button.sample().
+		*/
+		static byte readInput()
+		{
+			byte input = 0;
+			if (button.left.raw())
+				input |= PLATFORM_LEFT;
+			if (button.right.raw())
+				input |= PLATFORM_RIGHT;
+			return input;
 		}
 
 		/*
 			Returns true if platform was moved.
 		*/
 		bool getUserInput()
+		{
+			return move(readInput());
+		}
+
+		/*
+			Moves the platform by the given PLATFORM_ bits.
+			Returns true if platform was moved.
+		*/
+		bool move(byte input)
 		{
 			int increment = 0;
 
-			if (button.left.raw())
+			if (input & PLATFORM_LEFT)
 			{
 				if (posX > FIELD_WALL_THICKNESS + 1)
 					increment = -2;
 			}
-			else if (button.right.raw())
+			else if (input & PLATFORM_RIGHT)
 			{
 				if (posX < 128 - FIELD_WALL_THICKNESS - width)
 					increment = 2;
 			}
 
-			// erase platform only if position changed
 			if (increment != 0)
 			{
-				draw(COLOR_BLACK);
 				posX += increment;
 				return true;
 			}
@@ -319,30 +505,338 @@ private:
 
 	void drawField()
 	{
+#if RENDER_BANDS
+		bandRenderer.begin(); // walls are drawn with the first frame
+#else
 		display.drawFastVLine(0, 0, 160, COLOR_WHITE);
 		display.drawFastVLine(127, 0, 160, COLOR_WHITE);
+#endif
+	}
+
+	// redraws only the parts of the walls that were erased this frame
+	void repairField()
+	{
+		renderer.repair(0, 0, 1, 160, COLOR_WHITE);
+		renderer.repair(127, 0, 1, 160, COLOR_WHITE);
 	}
 
 	Ball ball;
 	Platform player1;
 	Platform player2;
-	byte mode = 0; // 0 playing single, 1 playing multi, 10 - training
+	byte mode = 0; // 0 playing single, 1 playing multi, 2 playing multi in lockstep, 10 - training
+
+	/*
+		In the lockstep mode both consoles simulate the same field, host's platform
+		is player1 at the bottom. Joining console draws it upside down.
+	*/
+	Lockstep lockstep;
+
+	bool mirrored() const
+	{
+		return mode == 2 && SETTINGS.id == 1;
+	}
+
+	// other console's platform as the packets say, player2 follows it smoothly
+	int16_t remoteX;	   // where it should be by now
+	int16_t remotePacketX; // where the last packet said it was
+	int8_t remoteVel;	   // px per step, guessed from the last two packets
+	byte remoteSteps;	   // steps since the last packet
+
+	// multiplayer packets, see NetPacket.h
+	NetEncoder encoder;
+	NetDecoder decoder;
+
+	// when to send them, see SendRate.h
+	SendRate sendRate;
+	byte sentPlatformX; // platform position in the last sent packet
+	bool hostNews;		// joining console: host's last packet moved its platform or changed the score
+
+	/*
+		True if the other console needs this console's state soon.
+		Host: the platform moved or the ball is going to the other console.
+		Joining console: the platform moved, the ball is coming to it (the
+		host follows its ball then), or the host's last packet had news, as
+		the host's packets only come back with the joining console's ones
+		(see RadioLink.h). Otherwise both back off, see SendRate.h.
+	*/
+	bool sendUrgent()
+	{
+		if (mode == 2)
+			return true; // the other console can't simulate without the inputs
+
+		if (player1.posX != sentPlatformX)
+			return true;
+
+		if (SETTINGS.id == 0)
+			return ball.velY < 0;
+
+		return ball.velY > 0 || hostNews;
+	}
+
+	/*
+		State that will be send over the radio in the multiplayer game.
+	*/
+	NetState getNetState(byte flags = 0)
+	{
+		NetState state;
+		state.ballPosX = ball.posX;
+		state.ballPosY = ball.posY;
+		state.ballVelX = ball.velX;
+		state.ballVelY = ball.velY;
+		state.platformPosX = player1.posX;
+		state.score = player1.points;
+		state.flags = flags;
+		return state;
+	}
+
+	/*
+		Takes the other platform's position from a packet.
+	*/
+	void remotePlatformReceived(byte packetX)
+	{
+		int16_t x = 128 - packetX - player2.width;
+
+		if (remoteSteps > 0 && remoteSteps <= REMOTE_PREDICT_STEPS)
+			remoteVel = constrain((x - remotePacketX) / remoteSteps, -2, 2);
+		else
+			remoteVel = 0;
+
+		remoteX = x;
+		remotePacketX = x;
+		remoteSteps = 0;
+	}
+
+	/*
+		Moves the other platform between packets, called every step.
+	*/
+	void updateRemotePlatform()
+	{
+		if (remoteSteps < 255)
+			remoteSteps++;
+		if (remoteSteps <= REMOTE_PREDICT_STEPS)
+			remoteX = constrain(remoteX + remoteVel, 0, 128 - player2.width);
+
+		int16_t move = constrain(remoteX - player2.posX, -REMOTE_PLATFORM_SPEED, REMOTE_PLATFORM_SPEED);
+		player2.posX += move;
+	}
+
+	/*
+		Returns false if the previous packet didn't get to the other console,
+		with ACK payloads that is only known when sending the next one.
+	*/
+	bool sendNetState(byte flags = 0)
+	{
+		bool delivered = radioLink.delivered();
+
+		// delta base moves only when the other console says what it decoded, see NetPacket.h
+		byte packet[NET_PACKET_MAX];
+		byte length = encoder.encode(getNetState(flags), decoder.sequence(), packet);
+		radioLink.send(packet, length);
+
+		return delivered;
+	}
+
+	/*
+		Sends this console's inputs in the lockstep mode, see Lockstep.h.
+	*/
+	bool sendLockstep(bool quit = false)
+	{
+		bool delivered = radioLink.delivered();
+
+		byte packet[LOCKSTEP_PACKET_MAX];
+		byte length = lockstep.encode(packet, quit);
+		radioLink.send(packet, length);
+
+		return delivered;
+	}
+
+	/*
+		Turns the buttons of the joining console into host's direction,
+		its field is drawn upside down.
+	*/
+	static byte mirrorInput(byte input)
+	{
+		return ((input & PLATFORM_LEFT) ? PLATFORM_RIGHT : 0) | ((input & PLATFORM_RIGHT) ? PLATFORM_LEFT : 0);
+	}
+
+	/*
+		Checks the ball against the platforms this console simulates.
+		Returns true if someone lost a point.
+	*/
+	bool checkScoring()
+	{
+		bool scored = false;
+
+		if (!ball.checkPlatformCollision(player1))
+		{
+			player1.points--; // points are stored inverted, 100 means 0 points, 99 means 1 point, etc.
+			ball.reset(FIXED(BALL_STARTING_VEL_Y / 2));
+			haptics.play(hapticPointLost);
+			sound.play(soundPointLost);
+			scored = true;
+		}
+
+		// check player2 collision only if this console simulates the whole field
+		if ((mode == 0 || mode == 2 || mode == 10) && !ball.checkPlatformCollision(player2))
+		{
+			player2.points--; // points are stored inverted, 100 means 0 points, 99 means 1 point, etc.
+			ball.reset(FIXED(-(BALL_STARTING_VEL_Y / 2)));
+			haptics.play(hapticPointLost);
+			sound.play(soundPointLost);
+			scored = true;
+		}
+
+		return scored;
+	}
+
+	// easy mode - try to move other platform
+	void moveEasyOpponent()
+	{
+		if (ball.velY >= 0)
+			return;
+
+		// get how much movement is required to have same position as ball
+		int movement = (ball.posX - player2.posX).toInt();
+
+		if (player2.posX > FIELD_WALL_THICKNESS || player2.posX < 128 - FIELD_WALL_THICKNESS - player2.width)
+		{
+			if (movement > 3)
+				player2.posX += 2;
+			else if (movement < 3)
+				player2.posX -= 2;
+		}
+	}
+
+	/*
+		Draws everything that moved since the last frame,
+		points - the score is shown in the middle of the field.
+
+		With the band renderer the ball, platforms and points stages time
+		listing their shapes, the drawing itself is all in the field stage,
+		as every band is composed from all of them at once.
+	*/
+	void drawMoved(bool points = false)
+	{
+#if RENDER_BANDS
+		bandRenderer.beginFrame();
+		bandRenderer.rect(0, 0, 1, 160);
+		bandRenderer.rect(127, 0, 1, 160);
+		{
+			PROFILE(PROFILE_BALL);
+			ball.compose(mirrored());
+		}
+		{
+			PROFILE(PROFILE_PLATFORMS);
+			player1.compose(mirrored());
+			player2.compose(mirrored());
+		}
+
+		if (points)
+		{
+			PROFILE(PROFILE_POINTS);
+			char buffer[BAND_TEXT_MAX + 1];
+			formatPoints(buffer, sizeof(buffer));
+			bandRenderer.text(buffer, -1, 75);
+		}
+
+		PROFILE(PROFILE_FIELD);
+		bandRenderer.endFrame();
+#else
+		renderer.beginFrame();
+		{
+			PROFILE(PROFILE_BALL);
+			ball.render(mirrored());
+		}
+		{
+			PROFILE(PROFILE_PLATFORMS);
+			player1.render(mirrored());
+			player2.render(mirrored());
+		}
+		{
+			PROFILE(PROFILE_FIELD);
+			repairField();
+		}
+#endif
+	}
+
+	/*
+		Shows the final score and waits for the player to leave.
+	*/
+	void showFinalScore(const __FlashStringHelper *title)
+	{
+		haptics.stop();
+
+		// points are stored inverted, fewer left means more scored
+		byte you = mirrored() ? player1.points : player2.points;
+		byte other = mirrored() ? player2.points : player1.points;
+		sound.play(you < other ? soundVictory : soundPointLost);
+
+		display.fillScreen(COLOR_BLACK);
+		print(title, 10, 10, COLOR_RED | COLOR_GREEN);
+		print(F("Final score was"), 20, 55);
+
+		printPoints();
+		button.clear();
+
+#if DISABLE_TEST_MENU == 0
+		display.setCursor(0, 150);
+		display.print(F("Missed steps "));
+		display.print(scheduler.missedStepCount());
+		display.print(F(" frames "));
+		display.print(scheduler.missedFrameCount());
+#endif
+
+		// wait for any key press
+		while (!button.esc.state() && !button.left.state())
+			tasks.idle();
+	}
+
+	// "You 1 - 0 other", as this console sees it
+	void formatPoints(char *buffer, byte size)
+	{
+		unsigned int you = PLAYER_POINTS_MAX - (mirrored() ? player1.points : player2.points);
+		unsigned int other = PLAYER_POINTS_MAX - (mirrored() ? player2.points : player1.points);
+		snprintf(buffer, size, "You %d - %d other", you, other);
+	}
 
 	void printPoints()
 	{
 		display.fillRect(FIELD_WALL_THICKNESS, 75, 128 - FIELD_WALL_THICKNESS * 2, 8, COLOR_BLACK);
 		char buffer[100] = {0};
-		snprintf(buffer, 99, "You %d - %d other", PLAYER_POINTS_MAX - player2.points, PLAYER_POINTS_MAX - player1.points);
+		formatPoints(buffer, sizeof(buffer));
 		printCentered(buffer, 75);
 	}
 
 	/*
-		Starts the game
+		Match state, see begin()
 	*/
+	bool updateBallPositionOnceMore; // used to detect if other player's ball bounced off
+	const __FlashStringHelper *endTitle;
+
+	/*
+		If showPoints = 0 - don't do anything
+		If showPoints != 0 but within SHOW_POINTS_TIMEOUT display points
+		Else - clear the display and set showPoints to 0
+	*/
+	unsigned long showPoints;
+
+	// ends the match with the final score under the title
+	void quit(const __FlashStringHelper *title)
+	{
+		endTitle = title;
+		Game::quit();
+	}
+
 public:
-	void pong_play()
+	Pong() : Game(PONG_STEP_US, PONG_RENDER_US) {}
+
+	/*
+		Starts the game. Physics runs in fixed steps (see FrameScheduler.h),
+		as many as needed to catch up with the time, then the screen is refreshed.
+	*/
+	void begin()
 	{
-		ball = Ball(128 / 2 - BALL_RADIUS / 2, 160 / 2 - BALL_RADIUS / 2, BALL_STARTING_VEL_X, BALL_STARTING_VEL_Y);
+		ball = Ball(128 / 2 - BALL_RADIUS / 2, 160 / 2 - BALL_RADIUS / 2, FIXED(BALL_STARTING_VEL_X), FIXED(BALL_STARTING_VEL_Y));
 		player1 = Platform(128 / 2 - 8, 160 - PLAYER_THICKNESS, 16);
 		player2 = Platform(128 / 2 - 8, 0, 16);
 
@@ -354,319 +848,343 @@ public:
 		// if playing multi and this is console 1, ball will start going towards the other player
 		else if (mode == 1 && SETTINGS.id == 1)
 		{
-			ball.reset(-(BALL_STARTING_VEL_Y / 2));
+			ball.reset(FIXED(-(BALL_STARTING_VEL_Y / 2)));
 		}
 		else
 		{
-			ball.reset(BALL_STARTING_VEL_Y / 2);
+			ball.reset(FIXED(BALL_STARTING_VEL_Y / 2));
 		}
 
 		display.fillScreen(COLOR_BLACK);
 		drawField();
-		radio.setPayloadSize(sizeof(GameData));
-		radio.flush_rx();
+		radioLink.flush();
 		radio.flush_tx();
+		lockstep.begin();
+
+		remoteX = remotePacketX = player2.posX;
+		remoteVel = 0;
+		remoteSteps = 0;
+
+		sendRate.begin();
+		sentPlatformX = player1.posX;
+		hostNews = false;
+		linkStats.newSequence();
+		updateBallPositionOnceMore = true;
+		showPoints = 0;
+
+#if ENABLE_PROFILER
+		profiler.begin(PONG_RENDER_US);
+#endif
+	}
 
-		unsigned long lastGameUpdate = 0;
-		unsigned long lastRadio = millis();
-		bool updateBallPositionOnceMore = true; // used to detect if other player's ball bounced off
+	bool update()
+	{
+		// in lockstep both consoles need the inputs of this step before simulating it
+		byte hostInput = 0, clientInput = 0;
+		if (mode == 2)
+		{
+			byte input = Platform::readInput();
+			bool advanced;
 
-		/*
-					If showPoints = 0 - don't do anything
-					If showPoints != 0 but within SHOW_POINTS_TIMEOUT display points
-					Else - clear the display and set showPoints to 0
-		*/
-		unsigned long showPoints = 0;
+			if (SETTINGS.id == 0)
+				advanced = lockstep.advance(input, hostInput, clientInput);
+			else
+				advanced = lockstep.advance(mirrorInput(input), clientInput, hostInput);
 
-		/*
-			During the multiplayer game:
-				If radio send returns false, counter is increased.
-				If radio send returns true, counter is reset to 0.
-		*/
-		int errorCounter = 0;
+			if (!advanced)
+				return false;
+		}
 
-		/*
-			Main game loop. Gets user input, refreshes the screen.
-		*/
-		while (1)
-		{
-			vibrate();
+		if (checkScoring())
+			showPoints = millis();
 
-			// update the positions and draw on the screen
-			if (millis() - lastGameUpdate > 25)
-			{
-				lastGameUpdate = millis();
+		ball.update();
 
-				// draw points display if needed
-				if (showPoints != 0)
-				{
-					if (millis() - showPoints < SHOW_POINTS_TIMEOUT)
-					{
-						printPoints();
-					}
-					else
-					{
-						display.fillRect(0, 75, 128, 20, COLOR_BLACK);
-						showPoints = 0;
-					}
-				}
+		if (mode == 2)
+		{
+			player1.move(hostInput);
+			player2.move(clientInput);
+		}
+		else
+			player1.getUserInput();
 
-				if (!ball.checkPlatformCollision(player1))
-				{
-					player1.points--; // points are stored inverted, 100 means 0 points, 99 means 1 point, etc.
-					showPoints = millis();
-					ball.reset(BALL_STARTING_VEL_Y / 2);
-					vibrate(VIBRATE_POINT_LOST);
-				}
+		if (mode == 1)
+			updateRemotePlatform();
 
-				// check player2 collision only if playing single player
-				if ((mode == 0 || mode == 10) && !ball.checkPlatformCollision(player2))
-				{
-					player2.points--; // points are stored inverted, 100 means 0 points, 99 means 1 point, etc.
-					showPoints = millis();
-					ball.reset(-(BALL_STARTING_VEL_Y / 2));
-					vibrate(VIBRATE_POINT_LOST);
-				}
+		if (mode == 0)
+			moveEasyOpponent();
 
-				ball.update();
+		return true;
+	}
 
-				player1.getUserInput();
+	void render()
+	{
+#if RENDER_BANDS
+		// score is drawn with the field
+		if (showPoints != 0 && millis() - showPoints >= SHOW_POINTS_TIMEOUT)
+			showPoints = 0;
+
+		drawMoved(showPoints != 0);
+#else
+		// draw points display if needed
+		if (showPoints != 0)
+		{
+			PROFILE(PROFILE_POINTS);
 
-				// easy mode - try to move other platform
-				if (mode == 0 && ball.velY < 0)
-				{
-					player2.draw(COLOR_BLACK);
+			if (millis() - showPoints < SHOW_POINTS_TIMEOUT)
+			{
+				printPoints();
+			}
+			else
+			{
+				display.fillRect(FIELD_WALL_THICKNESS, 75, 128 - FIELD_WALL_THICKNESS * 2, 20, COLOR_BLACK);
+				showPoints = 0;
+			}
 
-					// get how much movement is required to have same position as ball
-					int movement = ball.posX - player2.posX;
+			// points were drawn over the ball
+			ball.redraw();
+		}
 
-					if (player2.posX > FIELD_WALL_THICKNESS || player2.posX < 128 - FIELD_WALL_THICKNESS - player2.width)
-					{
-						if (movement > 3)
-							player2.posX += 2;
-						else if (movement < 3)
-							player2.posX -= 2;
-					}
-				}
+		drawMoved();
+#endif
 
-				player1.draw(COLOR_WHITE);
-				player2.draw(COLOR_WHITE);
+#if ENABLE_PROFILER
+		if (profiler.drawOverlay())
+			ball.redraw();
+#endif
+	}
 
-				drawField();
+	/*
+		Send game state. Called only after display drawn everything it needed.
+		In lockstep only the inputs are sent, also while waiting for the other console.
+	*/
+	void send()
+	{
+		if (mode != 1 && mode != 2)
+			return;
 
-				/*
-				Send game state. Do it only after display drawn everything it needed.
-				If this is host, send player1 and ball.
-				If this is client, send player2.
-				*/
-				if (mode == 1 && millis() - lastRadio > 100)
-				{
-					radio.stopListening();
-					bool radioResult = false;
+		if (sendRate.due(sendUrgent()))
+		{
+			PROFILE(PROFILE_RADIO);
+			sendRate.sent(mode == 1 ? sendNetState() : sendLockstep());
+			sentPlatformX = player1.posX;
+		}
 
-					GameData gd(player1, ball);
-					radioResult = radio.write(&gd, sizeof(gd));
+		if (sendRate.lost())
+		{
+			power.radioOff();
+			quit(F("Disconnected"));
+		}
+	}
 
-					if (radioResult)
-						errorCounter = 0;
-					else
-						errorCounter++;
+	/*
+		If data from the other console available.
+		If ball is moving towards this player, don't update the position.
+	*/
+	void receive()
+	{
+		if (mode == 1 || mode == 2)
+		{
+			PROFILE(PROFILE_RADIO);
+			radioLink.service();
+		}
 
-					if (errorCounter > 10)
-					{
-						vibrate(10000);
-						radio.powerDown();
+		if (mode == 2)
+		{
+			while (radioLink.available())
+			{
+				byte packet[RADIO_PACKET_MAX];
+				byte length = radioLink.receive(packet, sizeof(packet));
+				lockstep.decode(packet, length);
+			}
 
-						display.fillScreen(COLOR_BLACK);
-						print(F("Disconnected"), 10, 10, COLOR_RED | COLOR_GREEN);
-						print(F("Final score was"), 20, 55);
+			if (lockstep.quit())
+			{
+				power.radioOff();
+				quit(F("Other player left"));
+			}
+		}
 
-						printPoints();
+		if (mode == 1 && radioLink.available())
+		{
+			byte packet[RADIO_PACKET_MAX];
+			byte length = radioLink.receive(packet, sizeof(packet));
+			NetState gd;
 
-						while (1)
-						{
-							if (button.esc.state() == 1)
-								return;
-						}
-					}
+			bool decoded = length <= NET_PACKET_MAX && decoder.decode(packet, length, gd);
 
-					radio.startListening();
-					lastRadio = millis();
-				}
-			}
+			// also from a packet whose base this console doesn't have
+			encoder.acknowledged(decoder.acknowledgedSequence());
 
-			/*
-				If data from the other console available.
-				If ball is moving towards this player, don't update the position.
-			*/
-			if (mode == 1 && radio.available())
+			if (decoded)
 			{
-				uint8_t payloadSize = radio.getPayloadSize();
-				GameData gd;
+				linkStats.sequence(decoder.sequence());
 
-				if (payloadSize == sizeof(GameData))
+				if (gd.flags & NET_FLAG_QUIT)
 				{
-					radio.read(&gd, payloadSize);
+					power.radioOff();
+					quit(F("Other player left"));
+					return;
+				}
 
-					// update other platform position
-					player2.draw(COLOR_BLACK);
-					player2.posX = 128 - gd.platformPosX - player2.width;
-					player2.draw(COLOR_WHITE);
+				if (SETTINGS.id != 0)
+					hostNews = gd.platformPosX != (byte)(128 - remotePacketX - player2.width) || player2.points != gd.score;
 
-					if (player2.points != gd.score)
-					{
-						player2.points = gd.score;
-						showPoints = millis();
-					}
+				// other platform moves there over the next steps
+				remotePlatformReceived(gd.platformPosX);
 
-					// if ball is moving towards the other player, update the position
-					if (gd.ballVelY > 0 || updateBallPositionOnceMore)
-					{
-						if (gd.ballVelY <= 0)
-							updateBallPositionOnceMore = false;
-						else
-							updateBallPositionOnceMore = true;
-
-						ball.draw(COLOR_BLACK);
-						ball = Ball(128 - gd.ballPosX, 160 - gd.ballPosY, -gd.ballVelX, -gd.ballVelY);
-						ball.draw(COLOR_WHITE);
-					}
+				if (player2.points != gd.score)
+				{
+					player2.points = gd.score;
+					showPoints = millis();
+				}
 
-					lastRadio = millis() - 50;
+				// if ball is moving towards the other player, update the position
+				if (gd.ballVelY > 0 || updateBallPositionOnceMore)
+				{
+					if (gd.ballVelY <= 0)
+						updateBallPositionOnceMore = false;
+					else
+						updateBallPositionOnceMore = true;
+
+					ball.reconcile(128 - gd.ballPosX, 160 - gd.ballPosY, -gd.ballVelX, -gd.ballVelY);
 				}
-			}
 
-			// check for user input
-			if (button.esc.state() == 1)
-			{
-				vibrate(10000);
-				display.fillScreen(COLOR_BLACK);
-				print(F("Game ended"), 10, 10, COLOR_RED | COLOR_GREEN);
-				print(F("Final score was"), 20, 55);
+				// client's packet took the last ACK payload, load a fresh one soon
+				if (SETTINGS.id == 0)
+					sendRate.hurry();
+			}
+		}
+	}
 
-				printPoints();
+	void input(const ButtonEvent &event)
+	{
+		if (event.button == BUTTON_ESC)
+		{
+			// let the other console know, if this gets lost it will disconnect anyway
+			if (mode == 1)
+				sendNetState(NET_FLAG_QUIT);
+			else if (mode == 2)
+				sendLockstep(true);
 
-				// wait for any key press
-				while (!button.esc.state() && !button.left.state())
-					;
+			quit(F("Game ended"));
+		}
+		if (event.button == BUTTON_MENU)
+		{
+#if ENABLE_PROFILER
+			if (profiler.toggleOverlay())
+				ball.redraw();
+#endif
+		}
+	}
 
-				return;
-			}
-			if (button.menu.state() == 1)
-			{
-			}
+	void end()
+	{
+		// back to listening without a role, the radio is off until the next match
+		if (mode == 1 || mode == 2)
+		{
+			radioLink.endSession();
+			power.radioOff();
 		}
+
+		showFinalScore(endTitle);
 	}
 
 	/*
-		Goes to game's main menu.
+		Game's menu, for multiplayer also waits for the other console.
+		Returns false if it was left.
 	*/
-	int pong_menu()
+	bool menu()
 	{
-		byte menuSelector = 0;
+		menus.open(SETTINGS.id == 0 ? &menuPongHost : &menuPongJoin);
 
 		while (1)
 		{
-			radio.flush_rx();
+			radioLink.flush();
 			radio.flush_tx();
+
+			int action = menus.run();
+			if (action == MENU_BACK)
+				return false;
+
 			display.fillScreen(COLOR_BLACK);
-			printProgmem(menuMainPong, 10, 0);
-			printProgmem(menuMainPong + 1, menuOptionX, menuOptionY);
-			printProgmem(menuMainPong + 2 + SETTINGS.id, menuOptionX, menuOptionY + menuOptionHeight);
-			printProgmem(menuMainPong + 4, menuOptionX, menuOptionY + menuOptionHeight * 2);
 
-			menuSelector = getMenuSelector(menuSelector, 2);
-			bool innerLoop = true;
+			if (action == PONG_SINGLE || action == PONG_TRAINING)
+			{
+				mode = action == PONG_TRAINING ? 10 : 0;
+				return true;
+			}
+
+			// multi player
+			byte multiMode = action == PONG_LOCKSTEP ? 2 : 1;
+
+			// both consoles have to pick the same mode
+			byte hello = PONG_HELLO_VERSION | (multiMode == 2 ? PONG_HELLO_LOCKSTEP : 0);
+
+			print((const __FlashStringHelper *)_menu_0, 10, 0);
+			player2 = Platform(128 / 2 - 8, 0, 16);
 
-			while (innerLoop)
+			display.setCursor(0, 20);
+			display.println(F("Waiting for other"));
+			display.println(F("player to join...\n"));
+			display.print(F("This is console #"));
+			display.print(SETTINGS.id);
+
+			// enable radio, host only listens and answers in the acknowledgements, see RadioLink.h
+			power.radioOn();
+			tasks.sleep(250);
+			radioLink.startSession(SETTINGS.id == 0 ? RADIO_HOST : RADIO_CLIENT);
+
+			bool answered = false;	 // host: the answer is loaded
+			unsigned long lastHello = 0; // joining console: when the last hello was sent
+
+			while (1)
 			{
-				menuSelector = getMenuSelector();
+				radioLink.service();
 
-				if (button.esc.state() == 1 || button.left.state() == 1)
-				{
-					return 0;
-				}
-				if (button.ok.state() == 1 || button.right.state() == 1)
-				{
-					display.fillScreen(COLOR_BLACK);
+				byte packet[RADIO_PACKET_MAX];
+				byte length = radioLink.receive(packet, sizeof(packet));
+				bool matching = length == 1 && packet[0] == hello;
 
-					if (menuSelector == 0 || menuSelector == 2)
-					{
-						mode = menuSelector * 5; // if selecting 2, we want mode to be 10
-						return 1;
-					}
-					else if (menuSelector == 1)
+				// if radioNumber 0, then host, so wait until some client sends data
+				if (SETTINGS.id == 0)
+				{
+					if (matching)
 					{
-						// multi player
-						printProgmem(menuMainPong, 10, 0);
-						player2 = Platform(128 / 2 - 8, 0, 16);
-
-						display.setCursor(0, 20);
-						display.println(F("Waiting for other"));
-						display.println(F("player to join...\n"));
-						display.print(F("This is console #"));
-						display.print(SETTINGS.id);
-
-						// enable radio and start listening
-						radio.powerUp();
-						delay(250);
-
-						// if hosting, create this player and platform
-						if (SETTINGS.id == 0)
+						// this hello took the answer back
+						if (answered && radioLink.delivered())
 						{
-							radio.startListening();
-						}
-						else
-						{
-							radio.stopListening();
+							mode = multiMode;
+							return true;
 						}
 
-						// used to detect when connection successful or
-						// for time keeping if this console is client / joining
-						unsigned long dummyData = 0;
+						radioLink.send(&hello, sizeof(hello));
+						answered = true;
+					}
+				}
+				else
+				{
+					if (matching)
+					{
+						mode = multiMode;
+						return true;
+					}
 
-						while (1)
-						{
-							// if radioNumber 0, then host, so wait until some client sends data
-							if (SETTINGS.id == 0)
-							{
-								if (radio.available())
-								{
-									uint8_t bytes = radio.getPayloadSize();
-
-									radio.read(&dummyData, bytes);
-									if (dummyData != 0)
-									{
-										mode = 1;
-										return 1;
-									}
-								}
-							}
-							else
-							{
-								if (millis() - dummyData > 1000)
-								{
-									dummyData = millis();
-									bool radioResult = radio.write(&dummyData, sizeof(dummyData));
-
-									if (radioResult)
-									{
-										mode = 1;
-										return 1;
-									}
-								}
-							}
-
-							if (button.esc.state() == 1 || button.left.state() == 1)
-							{
-								display.fillScreen(COLOR_BLACK);
-								radio.powerDown();
-								innerLoop = false;
-								break;
-							}
-						}
+					if (millis() - lastHello > PONG_HELLO_INTERVAL)
+					{
+						lastHello = millis();
+						radioLink.send(&hello, sizeof(hello));
 					}
 				}
+
+				if (button.esc.state() == 1 || button.left.state() == 1)
+				{
+					radioLink.endSession();
+					power.radioOff();
+					break;
+				}
+
+				tasks.idle();
 			}
 		}
 	}
@@ -0,0 +1,105 @@
+#pragma once
+#include <avr/sleep.h>
+#include <RF24.h> // https://github.com/nRF24/RF24 - RF24 by TMRh20
+
+// all objects defined in main .ino file that will also be used here
+extern RF24 radio;
+
+/*
+	Power manager.
+
+	Loops that wait for something (menus, the game between steps) call
+	idle() instead of spinning: the CPU sleeps in idle mode until the next
+	interrupt. Timer0 keeps running, so it wakes at least every ~1 ms (the
+	button scan tick, see ButtonEvent.h), and also on the radio IRQ pin.
+	Timers, PWM of the vibrator and the buzzer keep working while it sleeps.
+
+	The radio is switched only through radioOn() / radioOff(), so the time
+	it was powered can be counted. It is on only during an exchange: the
+	wireless test, waiting for the other player and the match itself.
+	The host has to listen the whole match, it can't know when the client
+	sends. The client is in standby between packets already (~26 uA), and
+	powering it down would cost the ~5 ms power up delay of RF24 before
+	every packet, more than it saves.
+
+	Duty cycles (time awake, time the radio was on) are counted from the
+	last resetStats() and shown in the test menu.
+
+	Usage:
+		while (!done())
+			power.idle();
+*/
+class PowerManager
+{
+private:
+	unsigned long statsSince; // ms
+	unsigned long sleptMs;
+	unsigned long sleptUs; // below 1 ms, moved to sleptMs
+
+	bool radioPowered = false;
+	unsigned long radioSince;
+	unsigned long radioMs;
+
+public:
+	/*
+		Sleeps until the next interrupt.
+	*/
+	void idle()
+	{
+		unsigned long start = micros();
+
+		set_sleep_mode(SLEEP_MODE_IDLE);
+		sleep_enable();
+		sleep_cpu();
+		sleep_disable();
+
+		sleptUs += micros() - start;
+		if (sleptUs >= 1000)
+		{
+			sleptMs += sleptUs / 1000;
+			sleptUs %= 1000;
+		}
+	}
+
+	void radioOn()
+	{
+		if (radioPowered)
+			return;
+
+		radio.powerUp();
+		radioPowered = true;
+		radioSince = millis();
+	}
+
+	void radioOff()
+	{
+		radio.powerDown();
+
+		if (radioPowered)
+			radioMs += millis() - radioSince;
+		radioPowered = false;
+	}
+
+	void resetStats()
+	{
+		statsSince = millis();
+		sleptMs = sleptUs = 0;
+		radioMs = 0;
+		radioSince = statsSince;
+	}
+
+	// percent of the time the CPU was awake
+	byte awakePercent() const
+	{
+		unsigned long total = millis() - statsSince;
+		return total ? 100 - min(sleptMs, total) * 100 / total : 100;
+	}
+
+	// percent of the time the radio was powered
+	byte radioPercent() const
+	{
+		unsigned long total = millis() - statsSince;
+		unsigned long on = radioMs + (radioPowered ? millis() - radioSince : 0);
+		return total ? min(on, total) * 100 / total : 0;
+	}
+} power;
@@ -0,0 +1,206 @@
+#pragma once
+#include <Adafruit_ST7735.h> // https://github.com/adafruit/Adafruit-ST7735-Library library for ST7735
+#include "ButtonEvent.h"
+
+/*
+	Frame profiler for the game loop.
+
+	Parts of a frame are wrapped in scoped timers, each one adds its time
+	(micros()) to its stage, and min / avg / max per stage is shown on an
+	overlay. Frames that took longer than the budget are counted too.
+
+	With ENABLE_PROFILER 0 all the macros are empty, so nothing of this is
+	compiled in. The simulator can be built with it on:
+		make CXXFLAGS="-O2 -DENABLE_PROFILER=1"
+
+	Usage:
+		PROFILE_FRAME_BEGIN();
+		{
+			PROFILE(PROFILE_BALL);
+			ball.render();
+		}
+		PROFILE_FRAME_END(rendered);
+
+	Overlay shows the frames since it was last drawn, in ms, and drawing it
+	lands in the frame it was drawn in.
+*/
+#ifndef ENABLE_PROFILER
+#define ENABLE_PROFILER 0
+#endif
+
+#define PROFILE_PHYSICS 0
+#define PROFILE_POINTS 1
+#define PROFILE_BALL 2
+#define PROFILE_PLATFORMS 3
+#define PROFILE_FIELD 4
+#define PROFILE_RADIO 5
+#define PROFILE_FRAME 6
+#define PROFILE_STAGES 7
+
+#define PROFILER_OVERLAY_FRAMES 20 // frames between overlay updates
+#define PROFILER_OVERLAY_Y 8	   // below the top platform
+
+#if ENABLE_PROFILER
+
+extern Adafruit_ST7735 display;
+
+const char profileStageNames[PROFILE_STAGES][6] PROGMEM = {"phys", "pts", "ball", "plat", "field", "radio", "frame"};
+
+class Profiler
+{
+private:
+	struct Stage
+	{
+		uint16_t min, max;
+		unsigned long total;
+		uint16_t count;
+	} stages[PROFILE_STAGES];
+
+	unsigned long budget;
+	unsigned long frameStart;
+	unsigned int overBudget;
+	bool overlay = false;
+	byte framesSinceOverlay;
+
+	// prints time in 0.1 ms, right aligned to 5 characters
+	static void printTime(unsigned long us)
+	{
+		unsigned long tenths = (us + 50) / 100;
+		if (tenths < 1000)
+			display.print(' ');
+		if (tenths < 100)
+			display.print(' ');
+		display.print(tenths / 10);
+		display.print('.');
+		display.print(tenths % 10);
+	}
+
+public:
+	/*
+		Clears everything, budgetUs is the time one frame may take.
+	*/
+	void begin(unsigned long budgetUs)
+	{
+		budget = budgetUs;
+		overBudget = 0;
+		framesSinceOverlay = 0;
+		clear();
+	}
+
+	// clears the stages, not the over budget count
+	void clear()
+	{
+		for (byte i = 0; i < PROFILE_STAGES; i++)
+			stages[i] = {0xFFFF, 0, 0, 0};
+	}
+
+	void add(byte stage, unsigned long us)
+	{
+		Stage &s = stages[stage];
+		uint16_t time = min(us, 0xFFFFUL);
+		s.min = min(s.min, time);
+		s.max = max(s.max, time);
+		s.total += time;
+		s.count++;
+	}
+
+	void beginFrame()
+	{
+		frameStart = micros();
+	}
+
+	// only loops that drew a frame are counted
+	void endFrame(bool rendered)
+	{
+		if (!rendered)
+			return;
+
+		unsigned long time = micros() - frameStart;
+		add(PROFILE_FRAME, time);
+		if (time > budget)
+			overBudget++;
+	}
+
+	/*
+		Shows / hides the overlay, returns true if the screen under it was changed.
+	*/
+	bool toggleOverlay()
+	{
+		overlay = !overlay;
+		framesSinceOverlay = PROFILER_OVERLAY_FRAMES;
+
+		if (!overlay)
+			display.fillRect(1, PROFILER_OVERLAY_Y, 126, (PROFILE_STAGES + 1) * 8, COLOR_BLACK);
+		return !overlay;
+	}
+
+	/*
+		Call every frame, draws the overlay every PROFILER_OVERLAY_FRAMES frames.
+		Returns true if it drew, things under it have to be drawn again.
+	*/
+	bool drawOverlay()
+	{
+		if (!overlay || ++framesSinceOverlay < PROFILER_OVERLAY_FRAMES)
+			return false;
+		framesSinceOverlay = 0;
+
+		display.fillRect(1, PROFILER_OVERLAY_Y, 126, (PROFILE_STAGES + 1) * 8, COLOR_BLACK);
+		display.setTextColor(COLOR_GREEN);
+
+		for (byte i = 0; i < PROFILE_STAGES; i++)
+		{
+			const Stage &s = stages[i];
+			display.setCursor(2, PROFILER_OVERLAY_Y + i * 8);
+			display.print((const __FlashStringHelper *)profileStageNames[i]);
+			display.setCursor(38, PROFILER_OVERLAY_Y + i * 8);
+
+			if (s.count)
+			{
+				printTime(s.min);
+				printTime(s.total / s.count);
+				printTime(s.max);
+			}
+		}
+
+		display.setCursor(2, PROFILER_OVERLAY_Y + PROFILE_STAGES * 8);
+		display.print(F("over budget "));
+		display.print(overBudget);
+
+		clear();
+		return true;
+	}
+} profiler;
+
+/*
+	Adds the time until the end of the scope to the stage.
+*/
+class ProfileScope
+{
+private:
+	byte stage;
+	unsigned long start;
+
+public:
+	ProfileScope(byte stage)
+	{
+		this->stage = stage;
+		start = micros();
+	}
+
+	~ProfileScope()
+	{
+		profiler.add(stage, micros() - start);
+	}
+};
+
+#define PROFILE(stage) ProfileScope profileScope_##stage(stage)
+#define PROFILE_FRAME_BEGIN() profiler.beginFrame()
+#define PROFILE_FRAME_END(rendered) profiler.endFrame(rendered)
+
+#else
+
+#define PROFILE(stage)
+#define PROFILE_FRAME_BEGIN()
+#define PROFILE_FRAME_END(rendered)
+
+#endif
@@ -0,0 +1,315 @@
+#pragma once
+#include <RF24.h> // https://github.com/nRF24/RF24 - RF24 by TMRh20
+#include "LinkStats.h"
+
+// all objects defined in main .ino file that will also be used here
+extern RF24 radio;
+
+/*
+	Interrupt driven receiving for the radio.
+
+	Polling radio.available() costs an SPI transfer every time, even when
+	nothing came, and the display is on the same bus. Instead, the IRQ pin
+	of the module (D0) goes LOW when a packet arrives, which triggers a pin
+	change interrupt. The interrupt itself only takes note of it, the radio
+	can't be read from there because the display might be in the middle of
+	a transfer. The game loop calls service() at a point where the bus is
+	free, and only then the RX FIFO is read into a small queue in RAM.
+
+	Usage:
+		radioLink.begin(); // in setup(), after radio.begin()
+
+		radioLink.service();
+		byte packet[RADIO_PACKET_MAX];
+		byte length = radioLink.receive(packet, sizeof(packet));
+
+	D0 is also the serial RX pin, so Serial can't receive while this is used.
+
+	Sending:
+		Switching between listening and sending costs settling time every
+		packet and write() waits for the auto-ack. During a session one
+		console stays a receiver and the other a transmitter:
+			- RADIO_CLIENT only transmits, without waiting, the result comes
+			  later on the IRQ pin.
+			- RADIO_HOST only listens. What it sends is loaded as the ACK
+			  payload and goes back with the acknowledgement of the next
+			  packet from the client, so one exchange is one air transaction.
+		The host can only send when the client sends something, so the client
+		has to send regularly. Outside a session (RADIO_IDLE) the radio only
+		listens and nothing can be sent.
+
+		radioLink.startSession(SETTINGS.id == 0 ? RADIO_HOST : RADIO_CLIENT);
+		radioLink.send(packet, length);
+		...
+		if (!radioLink.delivered()) // the last packet didn't get through
+*/
+#define RADIO_IRQ_PIN 0	   // D0 = PD0 = PCINT16
+#define RADIO_QUEUE 4	   // packets kept in RAM
+#define RADIO_PACKET_MAX 16 // longer packets are cut
+
+#define RADIO_IDLE 0
+#define RADIO_HOST 1
+#define RADIO_CLIENT 2
+
+class RadioLink
+{
+private:
+	struct Packet
+	{
+		byte length;
+		byte data[RADIO_PACKET_MAX];
+	} queue[RADIO_QUEUE];
+	byte queueHead = 0;
+	byte queueCount = 0;
+
+	volatile bool pending = false;
+	volatile unsigned long pendingSince; // when the IRQ pin went LOW, only written while pending is false
+	byte dropped = 0;
+
+	byte role = RADIO_IDLE;
+	bool sending = false;	// client: packet is in the air
+	bool skipped = false;	// client: a packet wasn't sent while another one was in the air
+	bool lastDelivered = false;
+	bool loaded = false;		// host: an ACK payload is waiting for the client
+	unsigned long sentAt;		// when the last packet left, see sentTime()
+	unsigned long receivedAt;	// IRQ time of the last packets read from the radio
+
+public:
+	/*
+		Outside a client session only "packet received" drives the IRQ pin,
+		nothing else is sent then.
+	*/
+	void begin()
+	{
+		pinMode(RADIO_IRQ_PIN, INPUT);
+		radio.enableAckPayload();
+		radio.maskIRQ(1, 1, 0);
+
+		PCMSK2 |= _BV(PCINT16);
+		PCICR |= _BV(PCIE2);
+	}
+
+	/*
+		Sets how send() works, see above. Call with the radio powered up.
+	*/
+	void startSession(byte role)
+	{
+		this->role = role;
+		sending = false;
+		loaded = false;
+		skipped = false;
+		lastDelivered = false;
+
+		radio.flush_tx();
+		if (role == RADIO_CLIENT)
+		{
+			radio.stopListening();
+			radio.maskIRQ(0, 0, 0); // results of the writes come on the IRQ pin too
+		}
+		else
+		{
+			radio.startListening();
+			radio.maskIRQ(1, 1, 0);
+		}
+	}
+
+	/*
+		Back to RADIO_IDLE, listening, with no ACK payload left loaded.
+	*/
+	void endSession()
+	{
+		startSession(RADIO_IDLE);
+	}
+
+	/*
+		Sends a packet, see the roles above. Returns false outside a session,
+		or on the client if the previous packet is still in the air.
+	*/
+	bool send(const void *data, byte length)
+	{
+		if (role == RADIO_HOST)
+		{
+			// something came since the last send, so the last ACK payload went with it
+			service();
+			if (loaded)
+				linkStats.transmitted(lastDelivered, 0);
+
+			// only the newest state should go out
+			radio.flush_tx();
+			radio.writeAckPayload(1, data, length);
+			lastDelivered = false;
+			loaded = true;
+			return true;
+		}
+
+		if (role == RADIO_CLIENT)
+		{
+			service();
+			if (sending)
+			{
+				skipped = true;
+				lastDelivered = false;
+				linkStats.transmitted(false, 0);
+				return false;
+			}
+
+			sentAt = micros();
+			radio.startWrite(data, length, false);
+			sending = true;
+			lastDelivered = false;
+			return true;
+		}
+
+		return false;
+	}
+
+	/*
+		True if the last packet given to send() got to the other console.
+		Host knows it when the next packet from the client comes, client when
+		the acknowledgement comes, so check it just before sending the next one.
+	*/
+	bool delivered()
+	{
+		if (role != RADIO_IDLE)
+			service();
+		return lastDelivered;
+	}
+
+	/*
+		Called from the pin change interrupt only.
+	*/
+	void interrupt()
+	{
+		if (!(PIND & _BV(RADIO_IRQ_PIN)) && !pending)
+		{
+			pendingSince = micros();
+			pending = true;
+		}
+	}
+
+	/*
+		Moves received packets from the radio to the queue. Touches SPI only
+		if the IRQ pin said something arrived. Call from the game loop,
+		never while drawing.
+	*/
+	void service()
+	{
+		// pin is checked too, in case a packet came while the flag was being cleared
+		if (!pending && (PIND & _BV(RADIO_IRQ_PIN)))
+			return;
+		unsigned long irqAt = pending ? pendingSince : micros();
+		pending = false;
+
+		if (role == RADIO_CLIENT)
+		{
+			bool txOk, txFail, rxReady;
+			radio.whatHappened(txOk, txFail, rxReady);
+
+			if (txOk || txFail)
+			{
+				// failed packet stays in the TX FIFO and would block the next ones
+				if (txFail)
+					radio.flush_tx();
+				sending = false;
+				if (!skipped)
+					lastDelivered = txOk;
+				skipped = false;
+
+				if (txOk)
+					linkStats.roundTripTime(irqAt - sentAt);
+				linkStats.transmitted(txOk, radio.getARC());
+			}
+		}
+
+		while (radio.available())
+		{
+			byte length = radio.getDynamicPayloadSize();
+
+			// corrupted packet, datasheet says to flush it
+			if (length == 0 || length > 32)
+			{
+				radio.flush_rx();
+				break;
+			}
+
+			if (queueCount == RADIO_QUEUE)
+			{
+				// keep the newest, game state in the oldest one is already stale
+				queueHead = (queueHead + 1) % RADIO_QUEUE;
+				queueCount--;
+				dropped++;
+			}
+
+			Packet &packet = queue[(queueHead + queueCount) % RADIO_QUEUE];
+			packet.length = min(length, RADIO_PACKET_MAX);
+			radio.read(packet.data, packet.length);
+			queueCount++;
+			receivedAt = irqAt;
+
+			// the ACK payload loaded before went back with this packet
+			if (role == RADIO_HOST)
+			{
+				if (loaded && !lastDelivered)
+					sentAt = irqAt;
+				lastDelivered = true;
+			}
+		}
+	}
+
+	/*
+		Times in micros() for measuring round trips without the time the
+		packets waited for service() or for the client's next packet.
+		sentTime() is when the last packet given to send() left: client when
+		it was written, host when the client's packet took it back (valid
+		once delivered()). receivedTime() is when the IRQ pin said the last
+		received packet came.
+	*/
+	unsigned long sentTime() const
+	{
+		return sentAt;
+	}
+
+	unsigned long receivedTime() const
+	{
+		return receivedAt;
+	}
+
+	bool available() const
+	{
+		return queueCount > 0;
+	}
+
+	/*
+		Copies the oldest packet to out (cut to size) and returns its length,
+		0 if nothing was received.
+	*/
+	byte receive(void *out, byte size)
+	{
+		if (queueCount == 0)
+			return 0;
+
+		Packet &packet = queue[queueHead];
+		byte length = min(packet.length, size);
+		memcpy(out, packet.data, length);
+
+		queueHead = (queueHead + 1) % RADIO_QUEUE;
+		queueCount--;
+		return length;
+	}
+
+	/*
+		Drops everything received so far, in the radio and in the queue.
+	*/
+	void flush()
+	{
+		radio.flush_rx();
+		queueCount = 0;
+		pending = false;
+	}
+
+	// packets dropped because the queue was full
+	byte droppedCount() const
+	{
+		return dropped;
+	}
+} radioLink;
@@ -0,0 +1,281 @@
+#pragma once
+#include <Adafruit_ST7735.h> // https://github.com/adafruit/Adafruit-ST7735-Library library for ST7735
+
+extern Adafruit_ST7735 display;
+
+/*
+	Damage tracking renderer for moving sprites.
+
+	Instead of erasing a sprite in black and drawing it again in white
+	(two full draws, every pixel with its own address window), only the
+	pixels that are different between the old and the new position are sent,
+	each horizontal run of them with a single address window.
+
+	Pixels that turn black are remembered as "damage" for the current frame,
+	so the game can repair static things (walls, platforms) the sprite moved
+	away from, instead of redrawing them every frame.
+
+	Usage:
+		renderer.beginFrame();
+		renderer.moveCircle(2, oldX, oldY, true, newX, newY, COLOR_WHITE);
+		renderer.moveHLine(159, oldX, newX, 16, COLOR_WHITE);
+		renderer.repair(0, 0, 1, 160, COLOR_WHITE); // redraw the wall where it was erased
+*/
+#define RENDER_MAX_RADIUS 3 // circle mask rows are single bytes
+#define RENDER_MAX_RUN 16	// longest run of pixels sent at once
+#define RENDER_DAMAGE_RECTS 4
+
+class Renderer
+{
+private:
+	// mask of the circle outline, one byte per row, bit 0 is the leftmost pixel
+	byte circleRows[RENDER_MAX_RADIUS * 2 + 1];
+	byte circleRadius = 0;
+
+	// pixels erased this frame, as a few bounding boxes
+	struct Rect
+	{
+		int16_t x0, y0, x1, y1;
+	} damage[RENDER_DAMAGE_RECTS];
+	byte damageCount = 0;
+
+	void buildCircle(byte r)
+	{
+		circleMask(r, circleRows);
+		circleRadius = r;
+	}
+
+	static void plot(byte *rows, byte r, int8_t x, int8_t y)
+	{
+		rows[r + y] |= 1 << (r + x);
+	}
+
+	/*
+		Adds erased pixels x0-x1 in row y to the box they touch,
+		or to a new one. If all boxes are used the last one grows.
+	*/
+	void addDamage(int16_t x0, int16_t y, int16_t x1)
+	{
+		byte i = 0;
+		for (; i < damageCount; i++)
+		{
+			Rect &d = damage[i];
+			if (x0 <= d.x1 + 1 && x1 >= d.x0 - 1 && y >= d.y0 - 1 && y <= d.y1 + 1)
+				break;
+		}
+
+		if (i == damageCount)
+		{
+			if (damageCount < RENDER_DAMAGE_RECTS)
+			{
+				damage[damageCount++] = {x0, y, x1, y};
+				return;
+			}
+			i = damageCount - 1;
+		}
+
+		Rect &d = damage[i];
+		d.x0 = min(d.x0, x0);
+		d.x1 = max(d.x1, x1);
+		d.y0 = min(d.y0, y);
+		d.y1 = max(d.y1, y);
+	}
+
+	/*
+		Sends one row of pixels starting at x. Bit i of oldBits / newBits says
+		if pixel x + i belonged to the old / new sprite. Only pixels of one of the
+		sprites are touched, and runs without any changed pixel are skipped.
+	*/
+	void writeRow(int16_t x, int16_t y, uint16_t oldBits, uint16_t newBits, uint16_t color)
+	{
+		if (y < 0 || y >= display.height())
+			return;
+
+		uint16_t touched = oldBits | newBits;
+		uint16_t changed = oldBits ^ newBits;
+		uint16_t colors[RENDER_MAX_RUN];
+
+		for (byte i = 0; touched >> i; i++)
+		{
+			if (!(touched & (1 << i)))
+				continue;
+
+			// find the whole run
+			byte start = i;
+			while (i < RENDER_MAX_RUN && (touched & (1 << i)))
+				i++;
+			uint16_t runMask = ((1 << (i - start)) - 1) << start;
+
+			int16_t runX0 = x + start;
+			int16_t runX1 = x + i - 1;
+			if (runX0 < 0)
+				runX0 = 0;
+			if (runX1 >= display.width())
+				runX1 = display.width() - 1;
+			if (!(changed & runMask) || runX1 < runX0)
+				continue;
+
+			byte length = 0;
+			for (int16_t px = runX0; px <= runX1; px++)
+			{
+				bool on = newBits & (1 << (px - x));
+				colors[length++] = on ? color : 0;
+				if (!on)
+					addDamage(px, y, px);
+			}
+
+			display.setAddrWindow(runX0, y, length, 1);
+			display.writePixels(colors, length);
+		}
+	}
+
+public:
+	/*
+		Fills rows (r * 2 + 1 bytes) with the outline of a circle of radius r,
+		one byte per row, bit 0 is the leftmost pixel. Plotted the same way
+		Adafruit_GFX::drawCircle does, so the sprite looks exactly like before.
+	*/
+	static void circleMask(byte r, byte *rows)
+	{
+		memset(rows, 0, r * 2 + 1);
+
+		int8_t f = 1 - r;
+		int8_t ddF_x = 1;
+		int8_t ddF_y = -2 * r;
+		int8_t x = 0;
+		int8_t y = r;
+
+		plot(rows, r, 0, r);
+		plot(rows, r, 0, -r);
+		plot(rows, r, r, 0);
+		plot(rows, r, -r, 0);
+
+		while (x < y)
+		{
+			if (f >= 0)
+			{
+				y--;
+				ddF_y += 2;
+				f += ddF_y;
+			}
+			x++;
+			ddF_x += 2;
+			f += ddF_x;
+
+			plot(rows, r, x, y);
+			plot(rows, r, -x, y);
+			plot(rows, r, x, -y);
+			plot(rows, r, -x, -y);
+			plot(rows, r, y, x);
+			plot(rows, r, -y, x);
+			plot(rows, r, y, -x);
+			plot(rows, r, -y, -x);
+		}
+	}
+
+	/*
+		Call at the start of every frame, clears the damage.
+	*/
+	void beginFrame()
+	{
+		damageCount = 0;
+	}
+
+	/*
+		Moves a circle outline (radius up to RENDER_MAX_RADIUS) from one position to
+		another. If wasDrawn is false the old position is ignored and the circle is
+		only drawn. Background is assumed to be black.
+	*/
+	void moveCircle(byte radius, int16_t oldX, int16_t oldY, bool wasDrawn, int16_t newX, int16_t newY, uint16_t color)
+	{
+		if (radius != circleRadius)
+			buildCircle(radius);
+
+		const int16_t size = radius * 2 + 1;
+		int16_t dx = newX - oldX;
+		int16_t dy = newY - oldY;
+
+		display.startWrite();
+
+		// too far apart to share rows, do them one after another
+		if (!wasDrawn || abs(dx) > RENDER_MAX_RUN - size || abs(dy) >= size)
+		{
+			for (int16_t row = 0; row < size; row++)
+			{
+				if (wasDrawn)
+					writeRow(oldX - radius, oldY - radius + row, circleRows[row], 0, color);
+				writeRow(newX - radius, newY - radius + row, 0, circleRows[row], color);
+			}
+		}
+		else
+		{
+			int16_t left = min(oldX, newX) - radius;
+			int16_t top = min(oldY, newY) - radius;
+			int16_t bottom = max(oldY, newY) + radius;
+
+			for (int16_t y = top; y <= bottom; y++)
+			{
+				int16_t oldRow = y - (oldY - radius);
+				int16_t newRow = y - (newY - radius);
+				uint16_t oldBits = (oldRow >= 0 && oldRow < size) ? (uint16_t)circleRows[oldRow] << (oldX - radius - left) : 0;
+				uint16_t newBits = (newRow >= 0 && newRow < size) ? (uint16_t)circleRows[newRow] << (newX - radius - left) : 0;
+
+				writeRow(left, y, oldBits, newBits, color);
+			}
+		}
+
+		display.endWrite();
+	}
+
+	/*
+		Moves a horizontal line of the given width, only the columns at its ends
+		that changed are sent.
+	*/
+	void moveHLine(int16_t y, int16_t oldX, int16_t newX, int16_t width, uint16_t color)
+	{
+		if (oldX == newX)
+			return;
+
+		display.startWrite();
+
+		if (abs(newX - oldX) >= width)
+		{
+			display.writeFillRect(oldX, y, width, 1, 0);
+			display.writeFillRect(newX, y, width, 1, color);
+			addDamage(oldX, y, oldX + width - 1);
+		}
+		else if (newX > oldX)
+		{
+			display.writeFillRect(oldX, y, newX - oldX, 1, 0);
+			display.writeFillRect(oldX + width, y, newX - oldX, 1, color);
+			addDamage(oldX, y, newX - 1);
+		}
+		else
+		{
+			display.writeFillRect(newX, y, oldX - newX, 1, color);
+			display.writeFillRect(newX + width, y, oldX - newX, 1, 0);
+			addDamage(newX + width, y, oldX + width - 1);
+		}
+
+		display.endWrite();
+	}
+
+	/*
+		Fills the parts of the rectangle that were erased this frame.
+		Used for things that don't move, so they don't have to be redrawn every frame.
+	*/
+	void repair(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+	{
+		for (byte i = 0; i < damageCount; i++)
+		{
+			const Rect &d = damage[i];
+			int16_t x0 = max(x, d.x0);
+			int16_t y0 = max(y, d.y0);
+			int16_t x1 = min(x + w - 1, d.x1);
+			int16_t y1 = min(y + h - 1, d.y1);
+
+			if (x0 <= x1 && y0 <= y1)
+				display.fillRect(x0, y0, x1 - x0 + 1, y1 - y0 + 1, color);
+		}
+	}
+} renderer;
@@ -0,0 +1,104 @@
+#pragma once
+/*
+	Decides when the next multiplayer packet is sent.
+
+	Every packet costs air time and battery, but a late one is felt by the
+	other player. So packets are sent often only while it matters:
+		- urgent (the other console needs fresh state, for example the ball
+		  is coming to it): every SEND_RATE_FAST ms
+		- otherwise the time between packets doubles with every packet,
+		  from SEND_RATE_NORMAL up to SEND_RATE_IDLE
+
+	If a packet doesn't get through, the next one goes out fast, the other
+	side has stale state now. After SEND_RATE_RETRIES failures in a row the
+	other console is probably gone, so it backs off to SEND_RATE_IDLE until
+	nothing got through for SEND_RATE_TIMEOUT and the link is lost.
+
+	Usage:
+		sendRate.begin();
+		...
+		if (sendRate.due(urgent))
+			sendRate.sent(send()); // send returns if the previous packet got through
+		if (sendRate.lost())
+			disconnect();
+*/
+#define SEND_RATE_FAST 50	  // ms
+#define SEND_RATE_NORMAL 100  // ms
+#define SEND_RATE_IDLE 400	  // ms
+#define SEND_RATE_RETRIES 3	  // failures sent fast before backing off
+#define SEND_RATE_TIMEOUT 1500 // ms without a packet getting through
+#define SEND_RATE_SLACK 5	  // ms a packet may go early, due() is checked only once per frame
+
+class SendRate
+{
+private:
+	unsigned long lastSend;
+	unsigned long lastDelivered;
+	unsigned int interval;
+	byte failures;
+
+public:
+	/*
+		Call when the game starts, first packet is due right away.
+	*/
+	void begin()
+	{
+		lastSend = millis() - SEND_RATE_IDLE;
+		lastDelivered = millis();
+		interval = SEND_RATE_FAST;
+		failures = 0;
+	}
+
+	/*
+		Returns true if a packet should be sent now.
+		urgent - the other console needs fresh state soon
+	*/
+	bool due(bool urgent)
+	{
+		if (urgent && failures <= SEND_RATE_RETRIES)
+			interval = SEND_RATE_FAST;
+
+		return millis() - lastSend + SEND_RATE_SLACK >= interval;
+	}
+
+	/*
+		Call after every sent packet, delivered says if the previous one got through.
+	*/
+	void sent(bool delivered)
+	{
+		lastSend = millis();
+
+		if (delivered)
+		{
+			lastDelivered = lastSend;
+			failures = 0;
+			interval = constrain(interval * 2, SEND_RATE_NORMAL, SEND_RATE_IDLE);
+		}
+		else if (failures < 255 && ++failures <= SEND_RATE_RETRIES)
+			interval = SEND_RATE_FAST;
+		else
+			interval = SEND_RATE_IDLE;
+	}
+
+	/*
+		Next packet goes out within SEND_RATE_FAST, for answering
+		a packet that just came.
+	*/
+	void hurry()
+	{
+		if (millis() - lastSend < interval && interval > SEND_RATE_FAST)
+			lastSend = millis() - interval + SEND_RATE_FAST;
+	}
+
+	// nothing got through for SEND_RATE_TIMEOUT
+	bool lost() const
+	{
+		return millis() - lastDelivered > SEND_RATE_TIMEOUT;
+	}
+
+	// ms between packets right now
+	unsigned int currentInterval() const
+	{
+		return interval;
+	}
+};
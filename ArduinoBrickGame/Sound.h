@@ -0,0 +1,159 @@
+#pragma once
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "Settings.h"
+
+/*
+	Sound sequencer.
+
+	The buzzer is on D3, the OC2B output of Timer2. Timer2 runs in CTC mode
+	and toggles the pin by itself, so a note costs no CPU time at all while
+	it plays (tone() of the core toggles the pin from an interrupt, twice
+	per period). Notes of a sound are switched from the Timer0 interrupt
+	(tick(), every ~1 ms), the game loop never has to call anything.
+
+	Sounds are arrays of SoundNote in PROGMEM, built with NOTE() and REST()
+	and closed with SOUND_END. The timer values of a note are computed by
+	the compiler, playing one only copies them into the registers.
+
+	A sound that is started cuts the one that was playing. With the sound
+	turned off in the settings nothing plays.
+
+	Usage:
+		const SoundNote soundBeep[] PROGMEM = {NOTE(440, 100), REST(50), NOTE(880, 100), SOUND_END};
+		sound.play(soundBeep);
+		// and sound.tick() in the Timer0 interrupt
+*/
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#define SOUND_UNIT_TICKS 4 // note lengths are counted in 4 Timer0 ticks, ~4 ms
+
+/*
+	Timer2 setting for a frequency: clock select bits in the high byte,
+	OCR2A in the low byte, 0 means silence. Uses the smallest prescaler
+	OCR2A can hold the count for, the pin toggles every OCR2A + 1 counts.
+*/
+constexpr unsigned int soundPrescaler(byte clockSelect)
+{
+	return clockSelect == 1 ? 1 : clockSelect == 2 ? 8 : clockSelect == 3 ? 32 : clockSelect == 4 ? 64 : clockSelect == 5 ? 128 : clockSelect == 6 ? 256 : 1024;
+}
+
+constexpr unsigned long soundCounts(unsigned int freq, byte clockSelect)
+{
+	return F_CPU / (2UL * soundPrescaler(clockSelect) * freq);
+}
+
+constexpr uint16_t soundTimer(unsigned int freq, byte clockSelect = 1)
+{
+	return freq == 0 ? 0
+		   : soundCounts(freq, clockSelect) <= 256 ? (clockSelect << 8) | (soundCounts(freq, clockSelect) - 1)
+		   : clockSelect == 7						? (7 << 8) | 255
+												: soundTimer(freq, clockSelect + 1);
+}
+
+struct SoundNote
+{
+	uint16_t timer; // soundTimer() of the frequency
+	byte length;	// in SOUND_UNIT_TICKS, 0 ends the sound
+};
+
+#define NOTE(freq, ms) {soundTimer(freq), (ms) / SOUND_UNIT_TICKS}
+#define REST(ms) {0, (ms) / SOUND_UNIT_TICKS}
+#define SOUND_END {0, 0}
+
+const SoundNote soundWallHit[] PROGMEM = {NOTE(200, 48), SOUND_END};
+const SoundNote soundPlatformHit[] PROGMEM = {NOTE(400, 32), SOUND_END};
+const SoundNote soundPointLost[] PROGMEM = {NOTE(392, 100), NOTE(330, 100), NOTE(262, 200), SOUND_END};
+const SoundNote soundMenuClick[] PROGMEM = {NOTE(2000, 8), SOUND_END};
+const SoundNote soundLineClear[] PROGMEM = {NOTE(523, 48), NOTE(784, 80), SOUND_END};
+const SoundNote soundBatteryLow[] PROGMEM = {NOTE(880, 60), REST(60), NOTE(880, 60), SOUND_END};
+const SoundNote soundVictory[] PROGMEM = {NOTE(523, 100), REST(20), NOTE(659, 100), REST(20), NOTE(784, 100), REST(20), NOTE(1047, 300), SOUND_END};
+
+class SoundPlayer
+{
+private:
+	const SoundNote *volatile next = NULL; // next note of the playing sound
+	volatile uint16_t remaining;		   // ticks until the next note
+
+	static void output(uint16_t timer)
+	{
+		if (!timer)
+		{
+			TCCR2A = 0; // OC2B disconnected, the pin is low
+			TCCR2B = 0;
+			return;
+		}
+
+		TCCR2B = 0;
+		TCNT2 = 0;
+		OCR2A = timer & 0xFF;
+		OCR2B = 0;
+		TCCR2A = _BV(COM2B0) | _BV(WGM21); // toggle OC2B, CTC with OCR2A as top
+		TCCR2B = timer >> 8;
+	}
+
+	// starts the next note, or stops at the end of the sound
+	void nextNote()
+	{
+		byte length = pgm_read_byte(&next->length);
+		if (!length)
+		{
+			next = NULL;
+			output(0);
+			return;
+		}
+
+		output(pgm_read_word(&next->timer));
+		remaining = length * SOUND_UNIT_TICKS;
+		next++;
+	}
+
+public:
+	void play(const SoundNote *sound)
+	{
+		if (!SETTINGS.sound)
+			return;
+
+		noInterrupts();
+		next = sound;
+		nextNote();
+		interrupts();
+	}
+
+	/*
+		Plays one frequency until stop(), for the buzzer test. Not affected
+		by the sound setting.
+	*/
+	void tone(unsigned int freq)
+	{
+		noInterrupts();
+		next = NULL;
+		output(soundTimer(freq));
+		interrupts();
+	}
+
+	void stop()
+	{
+		noInterrupts();
+		next = NULL;
+		output(0);
+		interrupts();
+	}
+
+	bool playing() const
+	{
+		return next;
+	}
+
+	/*
+		Call from the Timer0 interrupt.
+	*/
+	void tick()
+	{
+		if (next && !--remaining)
+			nextNote();
+	}
+} sound;
@@ -0,0 +1,98 @@
+#pragma once
+#include "Power.h"
+
+/*
+	Cooperative task scheduler for background services.
+
+	A task is a function that does a bit of work and returns, run every
+	period ms (0 - every time the scheduler gets control). Tasks never
+	block and are never interrupted by each other, so they need no locks
+	and no stack of their own. When several are due, the one with the
+	higher priority runs first.
+
+	Loops that wait for something (menus, test screens, the game between
+	steps) call idle() instead of power.idle(): due tasks run, then the CPU
+	sleeps until the next interrupt. sleep() replaces delay(). So the
+	services keep running on whatever screen is shown, without every loop
+	having to know about them.
+
+	Things that have to happen at an exact time are not tasks, they run
+	in the Timer0 interrupt: button scan, battery sampling, sound and
+	haptics. The game itself is the foreground, paced by FrameScheduler.
+
+	Usage:
+		void blink() { ... }
+		tasks.add(blink, 500, TASK_PRIORITY_LOW); // in setup()
+
+		while (!done())
+			tasks.idle();
+*/
+#define TASK_MAX 4 // tasks that can be added
+
+#define TASK_PRIORITY_LOW 0
+#define TASK_PRIORITY_HIGH 1
+
+typedef void (*TaskFunction)();
+
+class TaskScheduler
+{
+private:
+	struct Task
+	{
+		TaskFunction run;
+		unsigned int period; // ms
+		byte priority;
+		unsigned long lastRun;
+	} tasks[TASK_MAX];
+	byte count = 0;
+
+public:
+	/*
+		Adds a task, kept in priority order. Returns false if the table is full.
+	*/
+	bool add(TaskFunction run, unsigned int period, byte priority)
+	{
+		if (count == TASK_MAX)
+			return false;
+
+		byte i = count++;
+		for (; i > 0 && tasks[i - 1].priority < priority; i--)
+			tasks[i] = tasks[i - 1];
+
+		tasks[i] = {run, period, priority, millis()};
+		return true;
+	}
+
+	// runs the tasks that are due
+	void run()
+	{
+		unsigned long now = millis();
+
+		for (byte i = 0; i < count; i++)
+		{
+			Task &task = tasks[i];
+			if (now - task.lastRun < task.period)
+				continue;
+
+			task.lastRun = now;
+			task.run();
+		}
+	}
+
+	/*
+		Runs the due tasks, then sleeps until the next interrupt.
+	*/
+	void idle()
+	{
+		run();
+		power.idle();
+	}
+
+	// like delay(), but the tasks keep running and the CPU sleeps
+	void sleep(unsigned long ms)
+	{
+		unsigned long start = millis();
+		while (millis() - start < ms)
+			idle();
+	}
+} tasks;
@@ -0,0 +1,379 @@
+#pragma once
+#include <Adafruit_ST7735.h> // https://github.com/adafruit/Adafruit-ST7735-Library library for ST7735
+#include "ButtonEvent.h"
+#include "Game.h"
+#include "Haptics.h"
+#include "MainMenu.h"
+#include "Sound.h"
+#include "Tasks.h"
+
+// all objects defined in main .ino file that will also be used here
+extern Adafruit_ST7735 display;
+
+/*
+	Tetris.
+
+	The board is a bitboard, one uint16_t per row. Columns 0 - 9 are bits
+	12 - 3, the bits on both sides are set and act as walls, so a piece
+	fits where (row & piece) == 0 and a row is full when it is 0xFFFF.
+	Clearing a line moves the words above it down.
+
+	Pieces are 4x4 masks in PROGMEM, one uint16_t per rotation, the top
+	row in the highest 4 bits and the left column in the highest bit of
+	each 4.
+
+	The screen keeps what is drawn as a second bitboard. A frame compares
+	each row of the board with the falling piece in it against it, and
+	only the cells that changed are drawn.
+
+	Controls: left / right move, up rotates, down drops faster, ok drops
+	the piece, esc ends the game.
+*/
+#define TETRIS_STEP_US 25000   // one game step
+#define TETRIS_RENDER_US 25000 // a frame every step
+
+#define TETRIS_ROWS 20
+#define TETRIS_COLUMNS 10
+#define TETRIS_ROW_EMPTY 0xE007 // only the walls
+#define TETRIS_ROW_FULL 0xFFFF
+#define TETRIS_ROW_CELLS 0x1FF8
+#define TETRIS_LEFT_BIT 12 // bit of column 0
+
+#define TETRIS_CELL 7 // px, the block is 1 px smaller
+#define TETRIS_BOARD_X 4
+#define TETRIS_BOARD_Y 10
+#define TETRIS_PANEL_X 82
+#define TETRIS_BLOCK_COLOR COLOR_WHITE
+
+#define TETRIS_FALL_START 32	  // steps between falls at level 0
+#define TETRIS_FALL_PER_LEVEL 3	  // steps faster every level
+#define TETRIS_FALL_MIN 3		  // fastest fall
+#define TETRIS_SOFT_DROP_STEPS 2  // while down is held
+#define TETRIS_LINES_PER_LEVEL 10
+#define TETRIS_REPEAT_DELAY 8	  // steps left / right is held before the piece keeps moving
+#define TETRIS_REPEAT_STEPS 3	  // then it moves every this many steps
+
+#define TETRIS_PIECES 7
+
+const uint16_t tetrisPieces[TETRIS_PIECES][4] PROGMEM = {
+	{0x0F00, 0x2222, 0x00F0, 0x4444}, // I
+	{0x6600, 0x6600, 0x6600, 0x6600}, // O
+	{0x4E00, 0x4640, 0x0E40, 0x4C40}, // T
+	{0x6C00, 0x4620, 0x06C0, 0x8C40}, // S
+	{0xC600, 0x2640, 0x0C60, 0x4C80}, // Z
+	{0x8E00, 0x6440, 0x0E20, 0x44C0}, // J
+	{0x2E00, 0x4460, 0x0E80, 0xC440}, // L
+};
+
+// score for 1 - 4 lines cleared at once, times (level + 1)
+const uint16_t tetrisLineScore[4] PROGMEM = {40, 100, 300, 1200};
+
+const char _game_tetris_over[] PROGMEM = "Game over";
+
+class Tetris : public Game
+{
+private:
+	uint16_t rows[TETRIS_ROWS];
+	uint16_t drawn[TETRIS_ROWS]; // cells on the screen, TETRIS_ROW_CELLS bits only
+
+	byte piece, next, rotation;
+	int8_t pieceX, pieceY; // of the top left corner of the 4x4 mask
+
+	byte fallCounter;
+	byte held, heldSteps; // left / right auto repeat
+
+	unsigned long score;
+	unsigned int lines;
+	bool panelDirty;
+
+	// row r (0 - 3) of the mask, moved to column x of the board
+	static uint16_t maskRow(uint16_t shape, byte r, int8_t x)
+	{
+		return (uint16_t)((shape << (r * 4)) & 0xF000) >> (x + 3);
+	}
+
+	static uint16_t shape(byte piece, byte rotation)
+	{
+		return pgm_read_word(&tetrisPieces[piece][rotation]);
+	}
+
+	bool fits(byte rotation, int8_t x, int8_t y) const
+	{
+		// outside of what the walls can stop
+		if (x < -3 || x > TETRIS_LEFT_BIT)
+			return false;
+
+		uint16_t mask = shape(piece, rotation);
+
+		for (byte r = 0; r < 4; r++)
+		{
+			uint16_t bits = maskRow(mask, r, x);
+			if (!bits)
+				continue;
+
+			int8_t row = y + r;
+			if (row >= TETRIS_ROWS)
+				return false;
+			if (bits & (row < 0 ? TETRIS_ROW_EMPTY : rows[row]))
+				return false;
+		}
+
+		return true;
+	}
+
+	byte level() const
+	{
+		return lines / TETRIS_LINES_PER_LEVEL;
+	}
+
+	byte fallSteps() const
+	{
+		int steps = TETRIS_FALL_START - TETRIS_FALL_PER_LEVEL * level();
+		return steps < TETRIS_FALL_MIN ? TETRIS_FALL_MIN : steps;
+	}
+
+	void spawn()
+	{
+		piece = next;
+		next = random(TETRIS_PIECES);
+		rotation = 0;
+		pieceX = 3;
+		pieceY = 0;
+		fallCounter = 0;
+		panelDirty = true;
+
+		if (!fits(rotation, pieceX, pieceY))
+		{
+			sound.play(soundPointLost);
+			quit();
+		}
+	}
+
+	bool move(int8_t dx)
+	{
+		if (!fits(rotation, pieceX + dx, pieceY))
+			return false;
+
+		pieceX += dx;
+		return true;
+	}
+
+	// with a kick of one column if the wall or the blocks are in the way
+	void rotate()
+	{
+		byte turned = (rotation + 1) & 3;
+		const int8_t kicks[] = {0, -1, 1};
+
+		for (byte i = 0; i < sizeof(kicks); i++)
+		{
+			if (fits(turned, pieceX + kicks[i], pieceY))
+			{
+				rotation = turned;
+				pieceX += kicks[i];
+				return;
+			}
+		}
+	}
+
+	// clears the full rows the piece landed in, returns how many
+	byte clearLines()
+	{
+		byte cleared = 0;
+
+		// top to bottom, moving the rows above down doesn't touch the ones still to check
+		for (int8_t row = pieceY; row < pieceY + 4 && row < TETRIS_ROWS; row++)
+		{
+			if (row < 0 || rows[row] != TETRIS_ROW_FULL)
+				continue;
+
+			memmove(&rows[1], &rows[0], row * sizeof(rows[0]));
+			rows[0] = TETRIS_ROW_EMPTY;
+			cleared++;
+		}
+
+		return cleared;
+	}
+
+	// piece becomes part of the board, the next one comes
+	void lock()
+	{
+		uint16_t mask = shape(piece, rotation);
+
+		for (byte r = 0; r < 4; r++)
+		{
+			int8_t row = pieceY + r;
+			if (row >= 0 && row < TETRIS_ROWS)
+				rows[row] |= maskRow(mask, r, pieceX);
+		}
+
+		byte cleared = clearLines();
+		if (cleared)
+		{
+			score += (unsigned long)pgm_read_word(&tetrisLineScore[cleared - 1]) * (level() + 1);
+			lines += cleared;
+			sound.play(cleared == 4 ? soundVictory : soundLineClear);
+			haptics.play(hapticWallHit);
+		}
+		else
+			sound.play(soundWallHit);
+
+		spawn();
+	}
+
+	void drop()
+	{
+		while (fits(rotation, pieceX, pieceY + 1))
+			pieceY++;
+		lock();
+	}
+
+	static void drawCell(int x, int y, uint16_t color)
+	{
+		display.fillRect(x, y, TETRIS_CELL - 1, TETRIS_CELL - 1, color);
+	}
+
+	// next piece and the numbers
+	void drawPanel()
+	{
+		uint16_t mask = shape(next, 0);
+		for (byte r = 0; r < 4; r++)
+		{
+			for (byte c = 0; c < 4; c++)
+			{
+				bool block = mask & (0x8000 >> (r * 4 + c));
+				drawCell(TETRIS_PANEL_X + c * TETRIS_CELL, TETRIS_BOARD_Y + 10 + r * TETRIS_CELL, block ? TETRIS_BLOCK_COLOR : COLOR_BLACK);
+			}
+		}
+
+		display.setTextColor(COLOR_WHITE, COLOR_BLACK); // background overwrites the old number
+		display.setCursor(TETRIS_PANEL_X, 70);
+		display.print(score);
+		display.setCursor(TETRIS_PANEL_X, 100);
+		display.print(lines);
+		display.setCursor(TETRIS_PANEL_X, 130);
+		display.print(level());
+	}
+
+public:
+	Tetris() : Game(TETRIS_STEP_US, TETRIS_RENDER_US) {}
+
+	// no options, starts right away
+	bool menu()
+	{
+		return true;
+	}
+
+	void begin()
+	{
+		for (byte row = 0; row < TETRIS_ROWS; row++)
+		{
+			rows[row] = TETRIS_ROW_EMPTY;
+			drawn[row] = 0;
+		}
+
+		display.fillScreen(COLOR_BLACK);
+		display.drawRect(TETRIS_BOARD_X - 2, TETRIS_BOARD_Y - 2, TETRIS_COLUMNS * TETRIS_CELL + 3, TETRIS_ROWS * TETRIS_CELL + 3, COLOR_WHITE);
+		print(F("Next"), TETRIS_PANEL_X, TETRIS_BOARD_Y);
+		print(F("Score"), TETRIS_PANEL_X, 60);
+		print(F("Lines"), TETRIS_PANEL_X, 90);
+		print(F("Level"), TETRIS_PANEL_X, 120);
+
+		score = 0;
+		lines = 0;
+		held = heldSteps = 0;
+
+		randomSeed(micros());
+		next = random(TETRIS_PIECES);
+		spawn();
+	}
+
+	bool update()
+	{
+		// held left / right keeps moving after a while, presses come in input()
+		byte now = (button.left.raw() ? 1 : 0) | (button.right.raw() ? 2 : 0);
+		if (now != held)
+		{
+			held = now;
+			heldSteps = 0;
+		}
+		else if ((held == 1 || held == 2) && ++heldSteps >= TETRIS_REPEAT_DELAY + TETRIS_REPEAT_STEPS)
+		{
+			heldSteps = TETRIS_REPEAT_DELAY;
+			move(held == 1 ? -1 : 1);
+		}
+
+		if (++fallCounter >= (button.down.raw() ? TETRIS_SOFT_DROP_STEPS : fallSteps()))
+		{
+			fallCounter = 0;
+			if (fits(rotation, pieceX, pieceY + 1))
+				pieceY++;
+			else
+				lock();
+		}
+
+		return true;
+	}
+
+	void render()
+	{
+		uint16_t mask = shape(piece, rotation);
+
+		for (byte row = 0; row < TETRIS_ROWS; row++)
+		{
+			uint16_t cells = rows[row];
+			int8_t r = row - pieceY;
+			if (r >= 0 && r < 4)
+				cells |= maskRow(mask, r, pieceX);
+			cells &= TETRIS_ROW_CELLS;
+
+			uint16_t changed = cells ^ drawn[row];
+			if (!changed)
+				continue;
+
+			for (byte column = 0; column < TETRIS_COLUMNS; column++)
+			{
+				uint16_t bit = 1 << (TETRIS_LEFT_BIT - column);
+				if (changed & bit)
+					drawCell(TETRIS_BOARD_X + column * TETRIS_CELL, TETRIS_BOARD_Y + row * TETRIS_CELL, cells & bit ? TETRIS_BLOCK_COLOR : COLOR_BLACK);
+			}
+			drawn[row] = cells;
+		}
+
+		if (panelDirty)
+		{
+			drawPanel();
+			panelDirty = false;
+		}
+	}
+
+	void input(const ButtonEvent &event)
+	{
+		if (event.button == BUTTON_LEFT)
+			move(-1);
+		else if (event.button == BUTTON_RIGHT)
+			move(1);
+		else if (event.button == BUTTON_UP)
+			rotate();
+		else if (event.button == BUTTON_OK)
+			drop();
+		else if (event.button == BUTTON_ESC)
+			quit();
+	}
+
+	void end()
+	{
+		haptics.stop();
+
+		display.fillScreen(COLOR_BLACK);
+		print((const __FlashStringHelper *)_game_tetris_over, 10, 10, COLOR_RED | COLOR_GREEN);
+		print(F("Score "), 20, 55);
+		print(score);
+		print(F("Lines "), 20, 65);
+		print(lines);
+		button.clear();
+
+		// wait for any key press
+		while (!button.esc.state() && !button.left.state())
+			tasks.idle();
+	}
+};
@@ -0,0 +1,178 @@
+/*
+	Host benchmark of the Pong game logic and of the display traffic it makes.
+
+	Usage: pong_bench [--scale N]
+		--scale N   multiplies the iteration counts (default 1)
+
+	Runs Ball::update(), Ball::checkPlatformCollision(), the easy mode
+	opponent and whole single player frames (physics step + drawing) in
+	tight loops, and prints one JSON object:
+		ns_per_op                   host time, noisy, only for comparing runs on one machine
+		avr_us_per_frame            virtual clock of the simulator, rough Nano time
+		display_*_per_frame, spi_bytes_per_frame
+		                            exact, any change means the drawing code changed
+
+	The sketch is compiled into this file the same way as in Sketch.cpp,
+	PongBench is a friend of Pong so it can reach the private parts.
+*/
+#include <Arduino.h>
+#include "../ArduinoBrickGame/ArduinoBrickGame.ino"
+
+// Arduino macros and the sketch's defines would clash with the simulator's names
+#undef abs
+#undef min
+#undef max
+#undef RADIO_IRQ_PIN
+#include <chrono>
+#include "Sim.h"
+
+#define BENCH_UPDATES 5000000UL
+#define BENCH_COLLISIONS 5000000UL
+#define BENCH_AI 5000000UL
+#define BENCH_FRAMES 200000UL
+
+class PongBench
+{
+private:
+	Pong pong;
+	volatile int sink = 0; // keeps results alive
+
+	typedef std::chrono::steady_clock Clock;
+
+	static double nsPerOp(Clock::time_point start, unsigned long iterations)
+	{
+		return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+	}
+
+	// same start as Pong::begin() in single player
+	void newGame()
+	{
+		pong.mode = 0;
+		pong.ball = Pong::Ball(128 / 2 - BALL_RADIUS / 2, 160 / 2 - BALL_RADIUS / 2, FIXED(BALL_STARTING_VEL_X), FIXED(BALL_STARTING_VEL_Y));
+		pong.ball.reset(FIXED(BALL_STARTING_VEL_Y / 2));
+		pong.player1 = Pong::Platform(128 / 2 - 8, 160 - PLAYER_THICKNESS, 16);
+		pong.player2 = Pong::Platform(128 / 2 - 8, 0, 16);
+	}
+
+	static void printResult(const char *name, unsigned long iterations, double ns, bool last = false)
+	{
+		printf("  \"%s\": {\"iterations\": %lu, \"ns_per_op\": %.2f}%s\n", name, iterations, ns, last ? "" : ",");
+	}
+
+public:
+	void ballUpdate(unsigned long iterations)
+	{
+		newGame();
+		Clock::time_point start = Clock::now();
+
+		for (unsigned long i = 0; i < iterations; i++)
+		{
+			pong.ball.update();
+
+			// keep it on the field, no platforms here
+			if (pong.ball.posY < 0 || pong.ball.posY > 159)
+				pong.ball.reset(FIXED(BALL_STARTING_VEL_Y / 2));
+		}
+
+		sink += pong.ball.posX.toInt();
+		printResult("ball_update", iterations, nsPerOp(start, iterations));
+	}
+
+	void collision(unsigned long iterations)
+	{
+		newGame();
+		Clock::time_point start = Clock::now();
+
+		// ball sweeps all positions around the bottom platform
+		for (unsigned long i = 0; i < iterations; i++)
+		{
+			pong.ball.posX = Fixed(i % 128);
+			pong.ball.posY = Fixed(150 + i / 128 % 10);
+			pong.ball.velY = (i & 1) ? FIXED(1.5) : FIXED(-1.5);
+			sink += pong.ball.checkPlatformCollision(pong.player1);
+		}
+
+		printResult("check_platform_collision", iterations, nsPerOp(start, iterations));
+	}
+
+	void easyOpponent(unsigned long iterations)
+	{
+		newGame();
+		pong.ball.velY = FIXED(-1.5);
+		Clock::time_point start = Clock::now();
+
+		for (unsigned long i = 0; i < iterations; i++)
+		{
+			pong.ball.posX = Fixed(i % 128);
+			pong.moveEasyOpponent();
+		}
+
+		sink += pong.player2.posX;
+		printResult("easy_opponent", iterations, nsPerOp(start, iterations));
+	}
+
+	/*
+		One physics step and one frame of drawing, like Pong::update() and
+		render() in single player with the platform moving left and right.
+	*/
+	void frames(unsigned long iterations)
+	{
+		newGame();
+		display.fillScreen(COLOR_BLACK);
+		pong.drawField();
+
+		sim::DisplayStats before = sim::displayStats;
+		uint64_t virtualStart = sim::nowNs();
+		Clock::time_point start = Clock::now();
+
+		for (unsigned long i = 0; i < iterations; i++)
+		{
+			pong.checkScoring();
+			pong.ball.update();
+			pong.player1.move((i / 40) % 2 ? PLATFORM_LEFT : PLATFORM_RIGHT);
+			pong.moveEasyOpponent();
+			pong.drawMoved();
+		}
+
+		double ns = nsPerOp(start, iterations);
+		const sim::DisplayStats &after = sim::displayStats;
+
+		printf("  \"frame\": {\"iterations\": %lu, \"ns_per_op\": %.2f, \"avr_us_per_frame\": %.1f, "
+			   "\"display_primitives_per_frame\": %.3f, \"display_windows_per_frame\": %.3f, "
+			   "\"display_pixels_per_frame\": %.3f, \"spi_bytes_per_frame\": %.3f}\n",
+			   iterations, ns,
+			   (sim::nowNs() - virtualStart) / 1000.0 / iterations,
+			   (double)(after.primitives - before.primitives) / iterations,
+			   (double)(after.windows - before.windows) / iterations,
+			   (double)(after.pixels - before.pixels) / iterations,
+			   (double)(after.bytes - before.bytes) / iterations);
+	}
+};
+
+int main(int argc, char **argv)
+{
+	unsigned long scale = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+			scale = strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "usage: %s [--scale N]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	display.initR(INITR_GREENTAB);
+
+	static PongBench bench;
+	printf("{\n");
+	bench.ballUpdate(BENCH_UPDATES * scale);
+	bench.collision(BENCH_COLLISIONS * scale);
+	bench.easyOpponent(BENCH_AI * scale);
+	bench.frames(BENCH_FRAMES * scale);
+	printf("}\n");
+
+	return 0;
+}
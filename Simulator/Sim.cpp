@@ -0,0 +1,1573 @@
+/*
+	Implementation of the host stand-ins (Arduino core, Adafruit_GFX/ST7735,
+	RF24, EEPROM) and of the simulator state from Sim.h.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "Sim.h"
+
+#include <Arduino.h>
+#include <Adafruit_ST7735.h>
+#include <RF24.h>
+#include <avr/eeprom.h>
+
+// the Arduino macros are only meant for the sketch
+#undef abs
+#undef min
+#undef max
+
+/*
+	Rough cost of each call on a 16 MHz Nano, in nanoseconds.
+*/
+#define COST_MILLIS 1000
+#define COST_MICROS 1500
+#define COST_PIN_MODE 4000
+#define COST_DIGITAL_READ 3200
+#define COST_DIGITAL_WRITE 3400
+#define COST_ANALOG_READ 112000
+#define COST_SPI_BYTE 1000	 // 8 MHz SPI clock
+#define COST_SPI_SELECT 1000 // chip select + SPI.beginTransaction
+#define COST_RADIO_REGISTER 12000
+#define COST_RADIO_TX_ACK 700000	// payload + auto-ack
+#define COST_RADIO_TX_FAIL 24000000 // setRetries(5, 15) all used up
+#define COST_RADIO_POWER_UP 5000000
+#define COST_RADIO_TX_SETTLE 280000
+#define COST_EEPROM_WRITE 3300000 // per changed byte
+#define COST_PORT_READ 125			 // in/lds of a port register
+#define COST_ISR_ENTRY 2500			 // vector jump + register push/pop
+#define COST_CLI_SEI 63				 // one cycle
+
+#define TIMER0_OVERFLOW_NS 1024000 // 16 MHz / 64 / 256
+#define ADC_CONVERSION_NS 104000	   // 13 ADC clocks at 16 MHz / 128
+
+namespace sim
+{
+	uint16_t framebuffer[DISPLAY_HEIGHT][DISPLAY_WIDTH];
+	DisplayStats displayStats;
+	FrameStats frameStats;
+	bool radioAck = false;
+	std::vector<std::vector<uint8_t>> radioSent;
+	RadioStats radioStats;
+	uint8_t eeprom[1024];
+	uint64_t cpuSleepNs = 0;
+	uint64_t buzzerNs = 0;
+	uint64_t vibratorNs = 0;
+
+	static uint64_t now = 0;
+	static uint64_t deadline = UINT64_MAX;
+
+	const int PIN_COUNT = 22;
+	static uint8_t pinIn[PIN_COUNT] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+	static int pinOut[PIN_COUNT];
+	static int analogIn[PIN_COUNT] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 798}; // A0 - battery at 3.9 V
+
+	struct ScriptEvent
+	{
+		uint64_t atNs;
+		uint8_t pin;
+		bool level;
+	};
+	static std::vector<ScriptEvent> script; // sorted by time
+	static size_t scriptNext = 0;
+
+	/*
+		Radio module state that is not in the RF24 object: the RX FIFO and
+		the status flags behind the IRQ pin.
+	*/
+	static std::vector<std::vector<uint8_t>> radioInbox;
+	struct RadioEvent
+	{
+		uint64_t atNs;
+		std::vector<uint8_t> packet;
+	};
+	static std::vector<RadioEvent> radioScript; // sorted by time
+	static size_t radioScriptNext = 0;
+	static bool radioReceiving = false;	   // powered up and listening
+	static bool radioTransmitting = false; // powered up and not listening
+	static bool radioPowered = false;
+	static uint64_t radioPoweredSince = 0, radioPoweredTotal = 0;
+
+	uint64_t radioPoweredNs()
+	{
+		return radioPoweredTotal + (radioPowered ? now - radioPoweredSince : 0);
+	}
+
+	static void radioPower(bool on)
+	{
+		if (on && !radioPowered)
+			radioPoweredSince = now;
+		else if (!on && radioPowered)
+			radioPoweredTotal += now - radioPoweredSince;
+		radioPowered = on;
+	}
+	static bool radioRxReady = false;	   // RX_DR status flag
+	static bool radioTxOk = false;		   // TX_DS status flag
+	static bool radioTxFail = false;	   // MAX_RT status flag
+	static bool radioRxMasked = false, radioTxOkMasked = false, radioTxFailMasked = false;
+
+	// ACK payloads
+	static bool radioAckPayloads = false;
+	static std::vector<uint8_t> radioPeerAckPayload, radioOwnAckPayload;
+	static bool radioHasPeerAckPayload = false, radioHasOwnAckPayload = false;
+
+	// write started with startWrite(), finishes at radioTxDoneNs
+	static uint64_t radioTxDoneNs = UINT64_MAX;
+	static bool radioTxAcked = false;
+
+	static void radioUpdateIrq()
+	{
+		bool irq = (radioRxReady && !radioRxMasked) || (radioTxOk && !radioTxOkMasked) || (radioTxFail && !radioTxFailMasked);
+		pinIn[RADIO_IRQ_PIN] = !irq;
+	}
+
+	static void radioArrive(const std::vector<uint8_t> &packet)
+	{
+		// the other console answers in the acknowledgement of the next write
+		if (radioTransmitting && radioAckPayloads)
+		{
+			radioPeerAckPayload = packet;
+			radioHasPeerAckPayload = true;
+			return;
+		}
+
+		if (!radioReceiving || radioInbox.size() >= 3)
+		{
+			radioStats.lost++;
+			return;
+		}
+
+		radioInbox.push_back(packet);
+		radioRxReady = true;
+		radioUpdateIrq();
+
+		if (radioAckPayloads && radioHasOwnAckPayload)
+		{
+			radioSent.push_back(radioOwnAckPayload);
+			if (radioSent.size() > RADIO_LOG)
+				radioSent.erase(radioSent.begin());
+			radioStats.ackPayloads++;
+			radioHasOwnAckPayload = false;
+		}
+	}
+
+	// write was acknowledged, the acknowledgement may carry a packet
+	static void radioAcked()
+	{
+		radioStats.acked++;
+
+		if (radioAckPayloads && radioHasPeerAckPayload && radioInbox.size() < 3)
+		{
+			radioInbox.push_back(radioPeerAckPayload);
+			radioHasPeerAckPayload = false;
+			radioRxReady = true;
+		}
+	}
+
+	static void radioTxDone()
+	{
+		radioTxDoneNs = UINT64_MAX;
+		if (radioTxAcked)
+		{
+			radioAcked();
+			radioTxOk = true;
+		}
+		else
+			radioTxFail = true;
+		radioUpdateIrq();
+	}
+
+	/*
+		Interrupts. Timer0 compare A fires once per Timer0 overflow like on
+		the Nano, pin change interrupt 2 (D0-D7) when an enabled pin changes.
+	*/
+	static bool interruptsOn = true;
+	static bool inInterrupt = false;
+	static uint64_t nextTimer0Ns = TIMER0_OVERFLOW_NS;
+	static uint8_t lastPortD = 0xFF;
+	static bool pinChange2Pending = false;
+	static uint64_t adcDoneNs = UINT64_MAX;
+	static uint64_t outputsCheckedNs = 0;
+
+	uint64_t nowNs()
+	{
+		return now;
+	}
+
+	static void applyScript()
+	{
+		while (scriptNext < script.size() && script[scriptNext].atNs <= now)
+		{
+			pinIn[script[scriptNext].pin] = script[scriptNext].level;
+			scriptNext++;
+		}
+
+		while (radioScriptNext < radioScript.size() && radioScript[radioScriptNext].atNs <= now)
+			radioArrive(radioScript[radioScriptNext++].packet);
+
+		if (radioTxDoneNs <= now)
+			radioTxDone();
+
+		if (TCCR2A & _BV(COM2B0))
+			buzzerNs += now - outputsCheckedNs;
+		if ((TCCR0A & _BV(COM0B1)) && OCR0B)
+			vibratorNs += now - outputsCheckedNs;
+		outputsCheckedNs = now;
+
+		// ADC, the conversion starts when the sketch sets ADSC and reads the pin at the end
+		if ((ADCSRA & _BV(ADSC)) && (ADCSRA & _BV(ADEN)) && adcDoneNs == UINT64_MAX)
+			adcDoneNs = now + ADC_CONVERSION_NS;
+		if (adcDoneNs <= now)
+		{
+			ADC = analogIn[A0 + (ADMUX & 0x07)];
+			ADCSRA = (ADCSRA & ~_BV(ADSC)) | _BV(ADIF);
+			adcDoneNs = UINT64_MAX;
+		}
+	}
+
+	static uint8_t portD()
+	{
+		uint8_t value = 0;
+		for (uint8_t i = 0; i < 8; i++)
+			value |= pinIn[i] << i;
+		return value;
+	}
+
+	/*
+		Runs a handler like the CPU would: no other interrupts inside it, and
+		the time it takes is added to whatever the sketch was doing.
+	*/
+	static uint64_t runInterrupt(void (*handler)(void))
+	{
+		uint64_t start = now;
+		inInterrupt = true;
+
+		try
+		{
+			advanceNs(COST_ISR_ENTRY);
+			handler();
+		}
+		catch (...)
+		{
+			inInterrupt = false;
+			throw;
+		}
+
+		inInterrupt = false;
+		return now - start;
+	}
+
+	void advanceNs(uint64_t ns)
+	{
+		uint64_t target = now + ns;
+
+		// timer interrupts that come due during this call
+		while (!inInterrupt && nextTimer0Ns <= target)
+		{
+			if (nextTimer0Ns > now)
+				now = nextTimer0Ns;
+			applyScript();
+
+			if (now >= deadline)
+				throw Halt();
+
+			// with interrupts disabled it stays pending until sei(), only once like the flag on the chip
+			bool enabled = TIMSK0 & _BV(OCIE0A);
+			if (enabled && !interruptsOn)
+				break;
+
+			nextTimer0Ns += TIMER0_OVERFLOW_NS;
+			if (nextTimer0Ns <= now)
+				nextTimer0Ns = now - (now - nextTimer0Ns) % TIMER0_OVERFLOW_NS + TIMER0_OVERFLOW_NS;
+
+			if (enabled)
+				target += runInterrupt(simVectorTimer0CompA);
+		}
+
+		if (target > now)
+			now = target;
+		applyScript();
+
+		if (now >= deadline)
+			throw Halt();
+
+		// pin change interrupt, the flag is set even while the interrupt can't run
+		uint8_t port = portD();
+		if ((port ^ lastPortD) & PCMSK2 && (PCICR & _BV(PCIE2)))
+			pinChange2Pending = true;
+		lastPortD = port;
+
+		if (pinChange2Pending && interruptsOn && !inInterrupt)
+		{
+			pinChange2Pending = false;
+			runInterrupt(simVectorPcint2);
+		}
+
+		if ((ADCSRA & _BV(ADIF)) && (ADCSRA & _BV(ADIE)) && interruptsOn && !inInterrupt)
+		{
+			ADCSRA &= ~_BV(ADIF);
+			runInterrupt(simVectorAdc);
+		}
+	}
+
+	/*
+		Idle sleep: the clock jumps to the next event that raises an
+		interrupt, a Timer0 tick, a radio packet, the end of a transmission or
+		of an ADC conversion. Button changes are seen by the tick.
+	*/
+	static void sleepUntilInterrupt()
+	{
+		if (pinChange2Pending || !interruptsOn)
+			return;
+
+		uint64_t wake = nextTimer0Ns;
+		if (adcDoneNs < wake)
+			wake = adcDoneNs;
+		if (radioScriptNext < radioScript.size() && radioScript[radioScriptNext].atNs < wake)
+			wake = radioScript[radioScriptNext].atNs;
+		if (radioTxDoneNs < wake)
+			wake = radioTxDoneNs;
+
+		if (wake > now)
+		{
+			cpuSleepNs += wake - now;
+			advanceNs(wake - now);
+		}
+	}
+
+	void setDeadlineMs(uint64_t ms)
+	{
+		deadline = ms * 1000000;
+	}
+
+	void setPin(uint8_t pin, bool level)
+	{
+		if (pin < PIN_COUNT)
+			pinIn[pin] = level;
+	}
+
+	bool pinLevel(uint8_t pin)
+	{
+		return pin < PIN_COUNT && pinIn[pin];
+	}
+
+	int pinOutput(uint8_t pin)
+	{
+		return pin < PIN_COUNT ? pinOut[pin] : 0;
+	}
+
+	void setAnalog(uint8_t pin, int value)
+	{
+		if (pin < PIN_COUNT)
+			analogIn[pin] = value;
+	}
+
+	int buttonPin(const char *name)
+	{
+		// must match s_button in ButtonEvent.h
+		static const struct
+		{
+			const char *name;
+			uint8_t pin;
+		} buttons[] = {{"ok", A1}, {"esc", A2}, {"menu", A3}, {"up", A4}, {"right", A5}, {"down", 4}, {"left", 2}};
+
+		for (auto &b : buttons)
+		{
+			if (strcmp(b.name, name) == 0)
+				return b.pin;
+		}
+		return -1;
+	}
+
+	void scheduleButton(uint64_t atMs, uint8_t pin, bool pressed)
+	{
+		ScriptEvent e = {atMs * 1000000, pin, !pressed};
+		auto it = std::upper_bound(script.begin() + scriptNext, script.end(), e,
+								   [](const ScriptEvent &a, const ScriptEvent &b)
+								   { return a.atNs < b.atNs; });
+		script.insert(it, e);
+	}
+
+	/*
+		Frame tracking for the display, see FrameStats.
+	*/
+	static bool frameOpen = false;
+	static uint64_t frameLastNs = 0;
+	static DisplayStats frameStart;
+
+	void closeFrame()
+	{
+		if (!frameOpen)
+			return;
+		frameOpen = false;
+
+		uint64_t bytes = displayStats.bytes - frameStart.bytes;
+		uint64_t busy = displayStats.busyNs - frameStart.busyNs;
+		uint64_t primitives = displayStats.primitives - frameStart.primitives;
+
+		frameStats.frames++;
+		frameStats.bytesTotal += bytes;
+		frameStats.bytesMax = std::max(frameStats.bytesMax, bytes);
+		frameStats.busyNsTotal += busy;
+		frameStats.busyNsMax = std::max(frameStats.busyNsMax, busy);
+		frameStats.primitivesTotal += primitives;
+		frameStats.primitivesMax = std::max(frameStats.primitivesMax, primitives);
+		frameStats.windowsTotal += displayStats.windows - frameStart.windows;
+	}
+
+	static void displayTouch()
+	{
+		if (frameOpen && now - frameLastNs >= FRAME_GAP_MS * 1000000)
+			closeFrame();
+
+		if (!frameOpen)
+		{
+			frameOpen = true;
+			frameStart = displayStats;
+		}
+		frameLastNs = now;
+	}
+
+	static void displayPrimitive()
+	{
+		displayTouch();
+		displayStats.primitives++;
+	}
+
+	static void spiBytes(uint64_t bytes)
+	{
+		displayTouch();
+		displayStats.bytes += bytes;
+		displayStats.busyNs += bytes * COST_SPI_BYTE;
+		advanceNs(bytes * COST_SPI_BYTE);
+		frameLastNs = now;
+	}
+
+	bool writePPM(const char *path)
+	{
+		FILE *f = fopen(path, "wb");
+		if (!f)
+			return false;
+
+		fprintf(f, "P6\n%d %d\n255\n", DISPLAY_WIDTH, DISPLAY_HEIGHT);
+		for (int y = 0; y < DISPLAY_HEIGHT; y++)
+		{
+			for (int x = 0; x < DISPLAY_WIDTH; x++)
+			{
+				// this panel has red in the low bits, see the COLOR_ defines in ButtonEvent.h
+				uint16_t c = framebuffer[y][x];
+				uint8_t rgb[3] = {(uint8_t)((c & 0x1F) * 255 / 31), (uint8_t)(((c >> 5) & 0x3F) * 255 / 63), (uint8_t)((c >> 11) * 255 / 31)};
+				fwrite(rgb, 1, 3, f);
+			}
+		}
+
+		fclose(f);
+		return true;
+	}
+
+	void radioInject(const void *data, uint8_t len)
+	{
+		const uint8_t *bytes = (const uint8_t *)data;
+		radioArrive(std::vector<uint8_t>(bytes, bytes + len));
+	}
+
+	void scheduleRadio(uint64_t atMs, const std::vector<uint8_t> &packet)
+	{
+		RadioEvent e = {atMs * 1000000, packet};
+		auto it = std::upper_bound(radioScript.begin() + radioScriptNext, radioScript.end(), e,
+								   [](const RadioEvent &a, const RadioEvent &b)
+								   { return a.atNs < b.atNs; });
+		radioScript.insert(it, e);
+	}
+}
+
+using namespace sim;
+
+/*
+	AVR registers and interrupts
+*/
+volatile uint8_t TIMSK0 = _BV(TOIE0); // the core enables the overflow for millis()
+volatile uint8_t OCR0A = 0;
+volatile uint8_t TCCR0A = 0;
+volatile uint8_t OCR0B = 0;
+volatile uint8_t PCICR = 0;
+volatile uint8_t PCMSK0 = 0, PCMSK1 = 0, PCMSK2 = 0;
+volatile uint8_t TCCR2A = 0, TCCR2B = 0, TCNT2 = 0, OCR2A = 0, OCR2B = 0;
+volatile uint8_t UCSR0B = 0;
+volatile uint8_t ADMUX = 0;
+volatile uint8_t ADCSRA = 0;
+volatile uint16_t ADC = 0;
+
+void set_sleep_mode(uint8_t mode)
+{
+}
+
+void sleep_enable(void)
+{
+}
+
+void sleep_disable(void)
+{
+}
+
+void sleep_cpu(void)
+{
+	sleepUntilInterrupt();
+}
+
+extern "C" void __attribute__((weak)) simVectorTimer0CompA(void)
+{
+}
+
+extern "C" void __attribute__((weak)) simVectorPcint2(void)
+{
+}
+
+extern "C" void __attribute__((weak)) simVectorAdc(void)
+{
+}
+
+void cli(void)
+{
+	interruptsOn = false;
+	advanceNs(COST_CLI_SEI);
+}
+
+void sei(void)
+{
+	interruptsOn = true;
+	advanceNs(COST_CLI_SEI);
+}
+
+uint8_t simReadPort(char port)
+{
+	advanceNs(COST_PORT_READ);
+
+	// Nano pins: D0-D7 are port D, D8-D13 port B, A0-A5 (14-19) port C
+	uint8_t first = port == 'D' ? 0 : port == 'B' ? 8 : A0;
+	uint8_t count = port == 'D' ? 8 : 6;
+	uint8_t value = 0;
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		if (pinLevel(first + i))
+			value |= 1 << i;
+	}
+	return value;
+}
+
+/*
+	Arduino core
+*/
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	advanceNs(COST_PIN_MODE);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+	advanceNs(COST_DIGITAL_WRITE);
+	if (pin < PIN_COUNT)
+		pinOut[pin] = val;
+}
+
+int digitalRead(uint8_t pin)
+{
+	advanceNs(COST_DIGITAL_READ);
+	return pinLevel(pin) ? HIGH : LOW;
+}
+
+int analogRead(uint8_t pin)
+{
+	advanceNs(COST_ANALOG_READ);
+	if (pin < A0)
+		pin += A0;
+	return pin < PIN_COUNT ? analogIn[pin] : 0;
+}
+
+void analogWrite(uint8_t pin, int val)
+{
+	advanceNs(COST_DIGITAL_WRITE);
+	if (pin < PIN_COUNT)
+		pinOut[pin] = val;
+}
+
+unsigned long millis(void)
+{
+	advanceNs(COST_MILLIS);
+	return now / 1000000;
+}
+
+unsigned long micros(void)
+{
+	advanceNs(COST_MICROS);
+	return now / 1000;
+}
+
+void delay(unsigned long ms)
+{
+	advanceNs((uint64_t)ms * 1000000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	advanceNs((uint64_t)us * 1000);
+}
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration)
+{
+	advanceNs(COST_DIGITAL_WRITE);
+	if (pin < PIN_COUNT)
+		pinOut[pin] = frequency;
+}
+
+void noTone(uint8_t pin)
+{
+	advanceNs(COST_DIGITAL_WRITE);
+	if (pin < PIN_COUNT)
+		pinOut[pin] = 0;
+}
+
+/*
+	Serial
+*/
+HardwareSerial Serial;
+
+void HardwareSerial::begin(unsigned long baud)
+{
+	this->baud = baud;
+	UCSR0B |= _BV(TXEN0) | _BV(RXEN0);
+	advanceNs(COST_DIGITAL_WRITE);
+}
+
+void HardwareSerial::end(void)
+{
+	UCSR0B = 0;
+}
+
+void HardwareSerial::flush(void)
+{
+	fflush(stderr);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+	if (!(UCSR0B & _BV(TXEN0)))
+		return 0;
+
+	// start bit, 8 data bits, stop bit
+	advanceNs(10000000000ULL / baud);
+	fputc(c, stderr);
+	return 1;
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+	return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+static uint32_t randomState = 1;
+
+void randomSeed(unsigned long seed)
+{
+	if (seed != 0)
+		randomState = seed;
+}
+
+long random(long howbig)
+{
+	if (howbig == 0)
+		return 0;
+
+	randomState = randomState * 1103515245 + 12345;
+	return (randomState >> 16) % howbig;
+}
+
+long random(long howsmall, long howbig)
+{
+	if (howsmall >= howbig)
+		return howsmall;
+	return random(howbig - howsmall) + howsmall;
+}
+
+/*
+	Print, same formatting as the Arduino core
+*/
+size_t Print::write(const char *str)
+{
+	return write((const uint8_t *)str, strlen(str));
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t n = 0;
+	while (size--)
+		n += write(*buffer++);
+	return n;
+}
+
+size_t Print::print(const __FlashStringHelper *s)
+{
+	return write((const char *)s);
+}
+
+size_t Print::print(const char str[])
+{
+	return write(str);
+}
+
+size_t Print::print(char c)
+{
+	return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char b, int base)
+{
+	return print((unsigned long)b, base);
+}
+
+size_t Print::print(int n, int base)
+{
+	return print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base)
+{
+	return print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base)
+{
+	if (base == 0)
+		return write((uint8_t)n);
+
+	if (base == 10 && n < 0)
+	{
+		size_t t = print('-');
+		return printNumber(-n, 10) + t;
+	}
+	return printNumber(n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+	if (base == 0)
+		return write((uint8_t)n);
+	return printNumber(n, base);
+}
+
+size_t Print::print(double number, int digits)
+{
+	if (isnan(number))
+		return print("nan");
+	if (isinf(number))
+		return print("inf");
+	if (number > 4294967040.0 || number < -4294967040.0)
+		return print("ovf");
+
+	size_t n = 0;
+	if (number < 0.0)
+	{
+		n += print('-');
+		number = -number;
+	}
+
+	double rounding = 0.5;
+	for (int i = 0; i < digits; i++)
+		rounding /= 10.0;
+	number += rounding;
+
+	unsigned long intPart = (unsigned long)number;
+	double remainder = number - (double)intPart;
+	n += print(intPart);
+
+	if (digits > 0)
+		n += print('.');
+
+	while (digits-- > 0)
+	{
+		remainder *= 10.0;
+		unsigned int toPrint = (unsigned int)remainder;
+		n += print(toPrint);
+		remainder -= toPrint;
+	}
+
+	return n;
+}
+
+size_t Print::println(void)
+{
+	return write("\r\n");
+}
+
+size_t Print::println(const __FlashStringHelper *s)
+{
+	return print(s) + println();
+}
+
+size_t Print::println(const char c[])
+{
+	return print(c) + println();
+}
+
+size_t Print::println(char c)
+{
+	return print(c) + println();
+}
+
+size_t Print::println(int n, int base)
+{
+	return print(n, base) + println();
+}
+
+size_t Print::println(unsigned int n, int base)
+{
+	return print(n, base) + println();
+}
+
+size_t Print::println(long n, int base)
+{
+	return print(n, base) + println();
+}
+
+size_t Print::println(unsigned long n, int base)
+{
+	return print(n, base) + println();
+}
+
+size_t Print::println(double n, int digits)
+{
+	return print(n, digits) + println();
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base)
+{
+	char buf[8 * sizeof(long) + 1];
+	char *str = &buf[sizeof(buf) - 1];
+	*str = '\0';
+
+	if (base < 2)
+		base = 10;
+
+	do
+	{
+		char c = n % base;
+		n /= base;
+		*--str = c < 10 ? c + '0' : c + 'A' - 10;
+	} while (n);
+
+	return write(str);
+}
+
+/*
+	Adafruit_GFX
+*/
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h)
+{
+	_width = w;
+	_height = h;
+	cursor_x = cursor_y = 0;
+	textcolor = textbgcolor = 0xFFFF;
+	textsize = 1;
+	wrap = true;
+}
+
+void Adafruit_GFX::startWrite(void)
+{
+}
+
+void Adafruit_GFX::endWrite(void)
+{
+}
+
+void Adafruit_GFX::writePixel(int16_t x, int16_t y, uint16_t color)
+{
+	drawPixel(x, y, color);
+}
+
+void Adafruit_GFX::writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+	fillRect(x, y, w, h, color);
+}
+
+void Adafruit_GFX::writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+	drawFastVLine(x, y, h, color);
+}
+
+void Adafruit_GFX::writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+	drawFastHLine(x, y, w, color);
+}
+
+void Adafruit_GFX::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+	startWrite();
+	for (int16_t i = 0; i < h; i++)
+		writePixel(x, y + i, color);
+	endWrite();
+}
+
+void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+	startWrite();
+	for (int16_t i = 0; i < w; i++)
+		writePixel(x + i, y, color);
+	endWrite();
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+	startWrite();
+	for (int16_t i = x; i < x + w; i++)
+		writeFastVLine(i, y, h, color);
+	endWrite();
+}
+
+void Adafruit_GFX::fillScreen(uint16_t color)
+{
+	fillRect(0, 0, _width, _height, color);
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+	displayPrimitive();
+	startWrite();
+	writeFastHLine(x, y, w, color);
+	writeFastHLine(x, y + h - 1, w, color);
+	writeFastVLine(x, y, h, color);
+	writeFastVLine(x + w - 1, y, h, color);
+	endWrite();
+}
+
+void Adafruit_GFX::drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color)
+{
+	displayPrimitive();
+
+	int16_t f = 1 - r;
+	int16_t ddF_x = 1;
+	int16_t ddF_y = -2 * r;
+	int16_t x = 0;
+	int16_t y = r;
+
+	startWrite();
+	writePixel(x0, y0 + r, color);
+	writePixel(x0, y0 - r, color);
+	writePixel(x0 + r, y0, color);
+	writePixel(x0 - r, y0, color);
+
+	while (x < y)
+	{
+		if (f >= 0)
+		{
+			y--;
+			ddF_y += 2;
+			f += ddF_y;
+		}
+		x++;
+		ddF_x += 2;
+		f += ddF_x;
+
+		writePixel(x0 + x, y0 + y, color);
+		writePixel(x0 - x, y0 + y, color);
+		writePixel(x0 + x, y0 - y, color);
+		writePixel(x0 - x, y0 - y, color);
+		writePixel(x0 + y, y0 + x, color);
+		writePixel(x0 - y, y0 + x, color);
+		writePixel(x0 + y, y0 - x, color);
+		writePixel(x0 - y, y0 - x, color);
+	}
+	endWrite();
+}
+
+void Adafruit_GFX::drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[], int16_t w, int16_t h, uint16_t color)
+{
+	displayPrimitive();
+
+	int16_t byteWidth = (w + 7) / 8;
+	uint8_t b = 0;
+
+	startWrite();
+	for (int16_t j = 0; j < h; j++, y++)
+	{
+		for (int16_t i = 0; i < w; i++)
+		{
+			if (i & 7)
+				b <<= 1;
+			else
+				b = pgm_read_byte(&bitmap[j * byteWidth + i / 8]);
+			if (b & 0x80)
+				writePixel(x + i, y, color);
+		}
+	}
+	endWrite();
+}
+
+/*
+	Placeholder glyph: a 5x7 box with a few bits of the character code
+	inside, so different strings still look different in a screenshot.
+*/
+static uint8_t glyphColumn(unsigned char c, uint8_t i)
+{
+	if (c <= ' ' || c >= 0x7F)
+		return 0;
+	if (i == 0 || i == 4)
+		return 0x7F;
+	return 0x41 | (((c >> (2 * (i - 1))) & 0x03) << 3);
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size)
+{
+	if (x >= _width || y >= _height || (x + 6 * size - 1) < 0 || (y + 8 * size - 1) < 0)
+		return;
+
+	displayPrimitive();
+	startWrite();
+	for (int8_t i = 0; i < 5; i++)
+	{
+		uint8_t line = glyphColumn(c, i);
+		for (int8_t j = 0; j < 8; j++, line >>= 1)
+		{
+			if (line & 1)
+			{
+				if (size == 1)
+					writePixel(x + i, y + j, color);
+				else
+					writeFillRect(x + i * size, y + j * size, size, size, color);
+			}
+			else if (bg != color)
+			{
+				if (size == 1)
+					writePixel(x + i, y + j, bg);
+				else
+					writeFillRect(x + i * size, y + j * size, size, size, bg);
+			}
+		}
+	}
+	if (bg != color)
+	{
+		if (size == 1)
+			writeFastVLine(x + 5, y, 8, bg);
+		else
+			writeFillRect(x + 5 * size, y, size, 8 * size, bg);
+	}
+	endWrite();
+}
+
+size_t Adafruit_GFX::write(uint8_t c)
+{
+	if (c == '\n')
+	{
+		cursor_x = 0;
+		cursor_y += textsize * 8;
+	}
+	else if (c != '\r')
+	{
+		if (wrap && (cursor_x + textsize * 6) > _width)
+		{
+			cursor_x = 0;
+			cursor_y += textsize * 8;
+		}
+		drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize);
+		cursor_x += textsize * 6;
+	}
+	return 1;
+}
+
+void Adafruit_GFX::setCursor(int16_t x, int16_t y)
+{
+	cursor_x = x;
+	cursor_y = y;
+}
+
+void Adafruit_GFX::setTextColor(uint16_t c)
+{
+	textcolor = textbgcolor = c;
+}
+
+void Adafruit_GFX::setTextColor(uint16_t c, uint16_t bg)
+{
+	textcolor = c;
+	textbgcolor = bg;
+}
+
+void Adafruit_GFX::setTextSize(uint8_t s)
+{
+	textsize = s > 0 ? s : 1;
+}
+
+void Adafruit_GFX::setTextWrap(bool w)
+{
+	wrap = w;
+}
+
+/*
+	Adafruit_ST7735 / SPITFT
+*/
+Adafruit_ST7735::Adafruit_ST7735(int8_t cs, int8_t dc, int8_t rst) : Adafruit_GFX(DISPLAY_WIDTH, DISPLAY_HEIGHT)
+{
+	winX0 = winY0 = winX = winY = 0;
+	winX1 = DISPLAY_WIDTH - 1;
+	winY1 = DISPLAY_HEIGHT - 1;
+	writeDepth = 0;
+}
+
+void Adafruit_ST7735::initR(uint8_t options)
+{
+	// the init sequence is ~100 bytes and ~700 ms of delays in the library
+	spiBytes(100);
+	delay(700);
+	memset(framebuffer, 0, sizeof(framebuffer));
+}
+
+void Adafruit_ST7735::setRotation(uint8_t m)
+{
+	spiBytes(2);
+}
+
+void Adafruit_ST7735::invertDisplay(bool i)
+{
+	spiBytes(1);
+}
+
+void Adafruit_ST7735::startWrite(void)
+{
+	if (writeDepth++ == 0)
+	{
+		displayTouch();
+		displayStats.transactions++;
+		displayStats.busyNs += COST_SPI_SELECT;
+		advanceNs(COST_SPI_SELECT);
+	}
+}
+
+void Adafruit_ST7735::endWrite(void)
+{
+	if (writeDepth > 0)
+		writeDepth--;
+}
+
+void Adafruit_ST7735::setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+	winX0 = winX = x;
+	winY0 = winY = y;
+	winX1 = x + w - 1;
+	winY1 = y + h - 1;
+
+	// CASET + 4 bytes, RASET + 4 bytes, RAMWR
+	displayStats.windows++;
+	spiBytes(11);
+}
+
+/*
+	Stores one pixel at the controller's write pointer and moves the
+	pointer, wrapping inside the address window like the ST7735 does.
+*/
+static inline void pushPixel(uint16_t color, uint16_t &x, uint16_t &y, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+	if (x < DISPLAY_WIDTH && y < DISPLAY_HEIGHT)
+		framebuffer[y][x] = color;
+
+	if (++x > x1)
+	{
+		x = x0;
+		if (++y > y1)
+			y = y0;
+	}
+}
+
+void Adafruit_ST7735::writePixels(uint16_t *colors, uint32_t len, bool block, bool bigEndian)
+{
+	for (uint32_t i = 0; i < len; i++)
+		pushPixel(colors[i], winX, winY, winX0, winY0, winX1, winY1);
+
+	displayStats.pixels += len;
+	spiBytes(2 * (uint64_t)len);
+}
+
+void Adafruit_ST7735::writeColor(uint16_t color, uint32_t len)
+{
+	for (uint32_t i = 0; i < len; i++)
+		pushPixel(color, winX, winY, winX0, winY0, winX1, winY1);
+
+	displayStats.pixels += len;
+	spiBytes(2 * (uint64_t)len);
+}
+
+void Adafruit_ST7735::writePixel(int16_t x, int16_t y, uint16_t color)
+{
+	if (x < 0 || x >= _width || y < 0 || y >= _height)
+		return;
+
+	setAddrWindow(x, y, 1, 1);
+	writeColor(color, 1);
+}
+
+void Adafruit_ST7735::writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+	// clip like the library does
+	if (w < 0)
+	{
+		x += w + 1;
+		w = -w;
+	}
+	if (h < 0)
+	{
+		y += h + 1;
+		h = -h;
+	}
+	if (x < 0)
+	{
+		w += x;
+		x = 0;
+	}
+	if (y < 0)
+	{
+		h += y;
+		y = 0;
+	}
+	if (x + w > _width)
+		w = _width - x;
+	if (y + h > _height)
+		h = _height - y;
+	if (w <= 0 || h <= 0)
+		return;
+
+	setAddrWindow(x, y, w, h);
+	writeColor(color, (uint32_t)w * h);
+}
+
+void Adafruit_ST7735::writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+	writeFillRect(x, y, 1, h, color);
+}
+
+void Adafruit_ST7735::writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+	writeFillRect(x, y, w, 1, color);
+}
+
+void Adafruit_ST7735::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+	displayPrimitive();
+	startWrite();
+	writePixel(x, y, color);
+	endWrite();
+}
+
+void Adafruit_ST7735::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+	displayPrimitive();
+	startWrite();
+	writeFillRect(x, y, w, h, color);
+	endWrite();
+}
+
+void Adafruit_ST7735::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+	displayPrimitive();
+	startWrite();
+	writeFillRect(x, y, 1, h, color);
+	endWrite();
+}
+
+void Adafruit_ST7735::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+	displayPrimitive();
+	startWrite();
+	writeFillRect(x, y, w, 1, color);
+	endWrite();
+}
+
+void Adafruit_ST7735::pushColor(uint16_t color)
+{
+	startWrite();
+	writeColor(color, 1);
+	endWrite();
+}
+
+/*
+	RF24
+*/
+static void radioRegister(int count = 1)
+{
+	radioStats.spiOps += count;
+	advanceNs(COST_RADIO_REGISTER * count);
+}
+
+RF24::RF24(uint16_t cePin, uint16_t csnPin)
+{
+	payloadSize = 32;
+	listening = false;
+	powered = false;
+	dynamicPayloads = false;
+}
+
+bool RF24::begin(void)
+{
+	radioRegister(20);
+	powerUp();
+	return true;
+}
+
+bool RF24::isChipConnected(void)
+{
+	radioRegister();
+	return true;
+}
+
+void RF24::setPALevel(uint8_t level, bool lnaEnable)
+{
+	radioRegister();
+}
+
+void RF24::setChannel(uint8_t channel)
+{
+	radioRegister();
+}
+
+void RF24::setRetries(uint8_t delay, uint8_t count)
+{
+	radioRegister();
+}
+
+void RF24::openWritingPipe(const uint8_t *address)
+{
+	radioRegister(3);
+}
+
+void RF24::openReadingPipe(uint8_t number, const uint8_t *address)
+{
+	radioRegister(3);
+}
+
+void RF24::powerDown(void)
+{
+	radioRegister();
+	powered = false;
+	radioPower(false);
+	radioTransmitting = false;
+	radioReceiving = false;
+}
+
+void RF24::powerUp(void)
+{
+	radioRegister();
+	if (!powered)
+		advanceNs(COST_RADIO_POWER_UP);
+	powered = true;
+	radioPower(true);
+	radioTransmitting = !listening;
+	radioReceiving = listening;
+}
+
+void RF24::startListening(void)
+{
+	radioRegister(3);
+	listening = true;
+	radioTransmitting = false;
+	radioReceiving = powered;
+}
+
+void RF24::stopListening(void)
+{
+	advanceNs(COST_RADIO_TX_SETTLE);
+	radioRegister(2);
+	listening = false;
+	radioTransmitting = powered;
+	radioReceiving = false;
+}
+
+bool RF24::available(void)
+{
+	return available(NULL);
+}
+
+bool RF24::available(uint8_t *pipe_num)
+{
+	radioRegister();
+	if (radioInbox.empty())
+		return false;
+
+	if (pipe_num)
+		*pipe_num = 1;
+	return true;
+}
+
+void RF24::read(void *buf, uint8_t len)
+{
+	radioRegister();
+	advanceNs(len * COST_SPI_BYTE);
+	radioStats.reads++;
+
+	memset(buf, 0, len);
+	if (radioInbox.empty())
+		return;
+
+	std::vector<uint8_t> &packet = radioInbox.front();
+	memcpy(buf, packet.data(), std::min<size_t>(len, packet.size()));
+	radioInbox.erase(radioInbox.begin());
+
+	// the library clears RX_DR after every read
+	radioRxReady = false;
+	radioUpdateIrq();
+}
+
+// logs a packet the sketch transmits
+static void radioSend(const void *buf, uint8_t len, uint8_t payloadSize, bool dynamicPayloads)
+{
+	if (len > 32)
+		len = 32;
+
+	radioRegister();
+	advanceNs(len * COST_SPI_BYTE);
+	radioStats.writes++;
+
+	// without dynamic payloads every packet is padded to the payload size
+	std::vector<uint8_t> packet((const uint8_t *)buf, (const uint8_t *)buf + len);
+	if (!dynamicPayloads)
+		packet.resize(payloadSize);
+	radioSent.push_back(packet);
+	if (radioSent.size() > RADIO_LOG)
+		radioSent.erase(radioSent.begin());
+}
+
+bool RF24::write(const void *buf, uint8_t len)
+{
+	radioSend(buf, len, payloadSize, dynamicPayloads);
+
+	if (!radioAck)
+	{
+		advanceNs(COST_RADIO_TX_FAIL);
+		return false;
+	}
+
+	advanceNs(COST_RADIO_TX_ACK);
+	radioAcked();
+	radioUpdateIrq();
+	return true;
+}
+
+void RF24::startWrite(const void *buf, uint8_t len, const bool multicast)
+{
+	radioSend(buf, len, payloadSize, dynamicPayloads);
+
+	radioTxAcked = radioAck && !multicast;
+	radioTxDoneNs = nowNs() + (radioAck ? COST_RADIO_TX_ACK : COST_RADIO_TX_FAIL);
+}
+
+void RF24::setPayloadSize(uint8_t size)
+{
+	radioRegister(6);
+	payloadSize = size > 32 ? 32 : size;
+}
+
+uint8_t RF24::getPayloadSize(void)
+{
+	return payloadSize;
+}
+
+void RF24::enableDynamicPayloads(void)
+{
+	radioRegister(2);
+	dynamicPayloads = true;
+}
+
+uint8_t RF24::getDynamicPayloadSize(void)
+{
+	radioRegister();
+	return radioInbox.empty() ? 0 : radioInbox.front().size();
+}
+
+void RF24::enableAckPayload(void)
+{
+	radioRegister(2);
+	radioAckPayloads = true;
+}
+
+bool RF24::writeAckPayload(uint8_t pipe, const void *buf, uint8_t len)
+{
+	if (len > 32)
+		len = 32;
+
+	radioRegister();
+	advanceNs(len * COST_SPI_BYTE);
+
+	// only the newest is kept, the sketch flushes the TX FIFO before loading anyway
+	radioOwnAckPayload.assign((const uint8_t *)buf, (const uint8_t *)buf + len);
+	radioHasOwnAckPayload = true;
+	return true;
+}
+
+void RF24::maskIRQ(bool tx_ok, bool tx_fail, bool rx_ready)
+{
+	radioRegister(2);
+	radioTxOkMasked = tx_ok;
+	radioTxFailMasked = tx_fail;
+	radioRxMasked = rx_ready;
+	radioUpdateIrq();
+}
+
+void RF24::whatHappened(bool &tx_ok, bool &tx_fail, bool &rx_ready)
+{
+	radioRegister();
+
+	// write() clears the TX flags before it returns, startWrite() leaves them set
+	tx_ok = radioTxOk;
+	tx_fail = radioTxFail;
+	rx_ready = radioRxReady;
+	radioTxOk = false;
+	radioTxFail = false;
+	radioRxReady = false;
+	radioUpdateIrq();
+}
+
+uint8_t RF24::getARC(void)
+{
+	radioRegister();
+
+	// every write is either acked right away or fails with all retries used
+	return radioAck ? 0 : 15;
+}
+
+uint8_t RF24::flush_rx(void)
+{
+	radioRegister();
+	radioInbox.clear();
+	return 0;
+}
+
+uint8_t RF24::flush_tx(void)
+{
+	radioRegister();
+	radioHasOwnAckPayload = false;
+	return 0;
+}
+
+/*
+	EEPROM
+*/
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+	size_t addr = (size_t)src;
+	if (addr + n <= sizeof(eeprom))
+		memcpy(dst, eeprom + addr, n);
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+	size_t addr = (size_t)dst;
+	if (addr + n > sizeof(eeprom))
+		return;
+
+	const uint8_t *bytes = (const uint8_t *)src;
+	for (size_t i = 0; i < n; i++)
+	{
+		if (eeprom[addr + i] != bytes[i])
+		{
+			eeprom[addr + i] = bytes[i];
+			advanceNs(COST_EEPROM_WRITE);
+		}
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+/*
+	Control surface of the host simulator.
+
+	The sketch itself never includes this file - it only sees the stand-in
+	library headers from include/. The driver (main.cpp) uses this to feed
+	button presses and radio packets in and to read the framebuffer and
+	the bus statistics out.
+
+	Time:
+		There is no real time. Each hardware call the sketch makes (millis(),
+		digitalRead(), every SPI byte...) is charged to a virtual clock with
+		a rough AVR cost, so the usual "millis() - last > 25" loops advance.
+		When the clock reaches the deadline, sim::Halt is thrown out of
+		whatever call the sketch was in.
+*/
+#include <stdint.h>
+#include <vector>
+
+namespace sim
+{
+	/*
+		Clock
+	*/
+	struct Halt
+	{
+	};
+
+	uint64_t nowNs();
+	void advanceNs(uint64_t ns);
+	void setDeadlineMs(uint64_t ms);
+
+	// time the sketch spent in sleep_cpu()
+	extern uint64_t cpuSleepNs;
+
+	// time Timer2 was driving the buzzer, and the vibrator PWM was on
+	extern uint64_t buzzerNs;
+	extern uint64_t vibratorNs;
+
+	/*
+		Pins. Levels are what digitalRead() returns, so buttons are
+		pressed when LOW (they use INPUT_PULLUP).
+	*/
+	void setPin(uint8_t pin, bool level);
+	bool pinLevel(uint8_t pin);
+	int pinOutput(uint8_t pin); // last value written with digitalWrite / analogWrite
+	void setAnalog(uint8_t pin, int value);
+
+	// returns the pin of a button by its name in s_button ("ok", "left"...) or -1
+	int buttonPin(const char *name);
+	// queues a button change that is applied when the clock reaches atMs
+	void scheduleButton(uint64_t atMs, uint8_t pin, bool pressed);
+
+	/*
+		Display
+	*/
+	const int DISPLAY_WIDTH = 128;
+	const int DISPLAY_HEIGHT = 160;
+	extern uint16_t framebuffer[DISPLAY_HEIGHT][DISPLAY_WIDTH];
+
+	struct DisplayStats
+	{
+		uint64_t primitives;   // GFX calls made by the sketch (drawCircle, fillRect, one text char...)
+		uint64_t transactions; // startWrite / endWrite pairs (chip select toggles)
+		uint64_t windows;	   // address windows set
+		uint64_t bytes;		   // bytes on the SPI bus
+		uint64_t pixels;	   // pixels written
+		uint64_t busyNs;	   // virtual time spent on the bus
+	};
+	extern DisplayStats displayStats;
+
+	/*
+		Display traffic is split into frames: a frame is a burst of display
+		calls with no gap of FRAME_GAP_MS or more inside it.
+	*/
+	const uint64_t FRAME_GAP_MS = 2;
+	struct FrameStats
+	{
+		uint64_t frames;
+		uint64_t bytesTotal, bytesMax;
+		uint64_t busyNsTotal, busyNsMax;
+		uint64_t primitivesTotal, primitivesMax;
+		uint64_t windowsTotal;
+	};
+	extern FrameStats frameStats;
+	void closeFrame();
+
+	bool writePPM(const char *path);
+
+	/*
+		Radio
+	*/
+	extern bool radioAck; // true if "the other console" acknowledges writes
+	void radioInject(const void *data, uint8_t len);
+	// queues a packet that arrives when the clock reaches atMs
+	void scheduleRadio(uint64_t atMs, const std::vector<uint8_t> &packet);
+	const uint8_t RADIO_IRQ_PIN = 0;
+	extern std::vector<std::vector<uint8_t>> radioSent; // newest last, capped at RADIO_LOG
+	const unsigned RADIO_LOG = 64;
+
+	struct RadioStats
+	{
+		uint64_t writes, acked, reads, spiOps;
+		uint64_t lost;		  // arrived while not listening or with the RX FIFO full
+		uint64_t ackPayloads; // sent by the sketch in acknowledgements
+	};
+	extern RadioStats radioStats;
+	uint64_t radioPoweredNs(); // time the radio was powered up so far
+
+	/*
+		EEPROM
+	*/
+	extern uint8_t eeprom[1024];
+}
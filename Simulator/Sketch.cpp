@@ -0,0 +1,6 @@
+/*
+	The whole sketch as one translation unit, the same way the Arduino
+	builder compiles it: Arduino.h first, then the .ino with its headers.
+*/
+#include <Arduino.h>
+#include "../ArduinoBrickGame/ArduinoBrickGame.ino"
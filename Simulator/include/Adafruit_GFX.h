@@ -0,0 +1,59 @@
+#pragma once
+/*
+	Host stand-in for Adafruit_GFX.
+
+	Primitives are implemented the same way the library does it (circles and
+	bitmaps are plotted pixel by pixel with writePixel(), lines and rects go
+	through writeFillRect()), so the number of address windows and bytes the
+	simulated display counts matches what the real library would send.
+
+	Text uses a placeholder 5x7 glyph for every printable character - text
+	positions and bus traffic are realistic, the shapes are not.
+*/
+#include <Arduino.h>
+
+class Adafruit_GFX : public Print
+{
+public:
+	Adafruit_GFX(int16_t w, int16_t h);
+
+	virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+	virtual void startWrite(void);
+	virtual void writePixel(int16_t x, int16_t y, uint16_t color);
+	virtual void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+	virtual void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+	virtual void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+	virtual void endWrite(void);
+
+	virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+	virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+	virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+	virtual void fillScreen(uint16_t color);
+
+	void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+	void drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+	void drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[], int16_t w, int16_t h, uint16_t color);
+	void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size);
+
+	void setCursor(int16_t x, int16_t y);
+	void setTextColor(uint16_t c);
+	void setTextColor(uint16_t c, uint16_t bg);
+	void setTextSize(uint8_t s);
+	void setTextWrap(bool w);
+
+	int16_t width(void) const { return _width; }
+	int16_t height(void) const { return _height; }
+	int16_t getCursorX(void) const { return cursor_x; }
+	int16_t getCursorY(void) const { return cursor_y; }
+
+	using Print::write;
+	virtual size_t write(uint8_t);
+
+protected:
+	int16_t _width, _height;
+	int16_t cursor_x, cursor_y;
+	uint16_t textcolor, textbgcolor;
+	uint8_t textsize;
+	bool wrap;
+};
@@ -0,0 +1,64 @@
+#pragma once
+/*
+	Host stand-in for Adafruit_ST7735 (and the Adafruit_SPITFT layer under it).
+
+	Drawing lands in the RGB565 framebuffer in Sim.h. Every address window
+	and every pixel pushed is counted as SPI bus traffic (11 command/data
+	bytes per window, 2 bytes per pixel) and charged to the virtual clock.
+*/
+#include <Adafruit_GFX.h>
+
+#define INITR_GREENTAB 0x00
+#define INITR_REDTAB 0x01
+#define INITR_BLACKTAB 0x02
+
+#define ST77XX_BLACK 0x0000
+#define ST77XX_WHITE 0xFFFF
+#define ST77XX_RED 0xF800
+#define ST77XX_GREEN 0x07E0
+#define ST77XX_BLUE 0x001F
+#define ST77XX_CYAN 0x07FF
+#define ST77XX_MAGENTA 0xF81F
+#define ST77XX_YELLOW 0xFFE0
+#define ST77XX_ORANGE 0xFC00
+
+#define ST7735_BLACK ST77XX_BLACK
+#define ST7735_WHITE ST77XX_WHITE
+#define ST7735_RED ST77XX_RED
+#define ST7735_GREEN ST77XX_GREEN
+#define ST7735_BLUE ST77XX_BLUE
+#define ST7735_CYAN ST77XX_CYAN
+#define ST7735_MAGENTA ST77XX_MAGENTA
+#define ST7735_YELLOW ST77XX_YELLOW
+#define ST7735_ORANGE ST77XX_ORANGE
+
+class Adafruit_ST7735 : public Adafruit_GFX
+{
+public:
+	Adafruit_ST7735(int8_t cs, int8_t dc, int8_t rst);
+
+	void initR(uint8_t options = INITR_GREENTAB);
+	void setRotation(uint8_t m);
+	void invertDisplay(bool i);
+
+	void startWrite(void);
+	void endWrite(void);
+	void setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+	void writePixel(int16_t x, int16_t y, uint16_t color);
+	void writePixels(uint16_t *colors, uint32_t len, bool block = true, bool bigEndian = false);
+	void writeColor(uint16_t color, uint32_t len);
+	void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+	void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+	void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+
+	void drawPixel(int16_t x, int16_t y, uint16_t color);
+	void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+	void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+	void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+	void pushColor(uint16_t color);
+
+private:
+	// current address window and write pointer inside it
+	uint16_t winX0, winY0, winX1, winY1, winX, winY;
+	uint8_t writeDepth;
+};
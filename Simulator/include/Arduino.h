@@ -0,0 +1,133 @@
+#pragma once
+/*
+	Host stand-in for the Arduino AVR core.
+
+	Only the parts of the core the sketch actually uses are here.
+	Every call that would take time on the Nano advances the virtual clock
+	(see Sim.h), so busy loops like "while (millis() - last < 25)" still
+	terminate and the sketch can be run headless.
+
+	Standard headers must be included before the Arduino macros below
+	(abs, min, max...), same as on the real core.
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <avr/pgmspace.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef unsigned int word;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+// Nano pin numbers
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+
+#define abs(x) ((x) > 0 ? (x) : -(x))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+
+#define interrupts() sei()
+#define noInterrupts() cli()
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+// same sequence for the same seed, like the core
+void randomSeed(unsigned long seed);
+long random(long howbig);
+long random(long howsmall, long howbig);
+
+/*
+	F() strings. On the host "flash" is ordinary memory, the type only
+	exists so overload resolution picks the same print() as on the Nano.
+*/
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
+
+class Print
+{
+public:
+	virtual size_t write(uint8_t) = 0;
+	size_t write(const char *str);
+	size_t write(const uint8_t *buffer, size_t size);
+
+	size_t print(const __FlashStringHelper *);
+	size_t print(const char[]);
+	size_t print(char);
+	size_t print(unsigned char, int = DEC);
+	size_t print(int, int = DEC);
+	size_t print(unsigned int, int = DEC);
+	size_t print(long, int = DEC);
+	size_t print(unsigned long, int = DEC);
+	size_t print(double, int = 2);
+
+	size_t println(const __FlashStringHelper *);
+	size_t println(const char[]);
+	size_t println(char);
+	size_t println(int, int = DEC);
+	size_t println(unsigned int, int = DEC);
+	size_t println(long, int = DEC);
+	size_t println(unsigned long, int = DEC);
+	size_t println(double, int = 2);
+	size_t println(void);
+
+private:
+	size_t printNumber(unsigned long, uint8_t);
+};
+
+/*
+	Serial port, what the sketch sends is written to stderr.
+	Each byte costs the time it takes on the wire.
+*/
+class HardwareSerial : public Print
+{
+public:
+	void begin(unsigned long baud);
+	void end(void);
+	void flush(void);
+	size_t write(uint8_t) override;
+	using Print::write;
+	operator bool() { return true; }
+
+private:
+	unsigned long baud = 9600;
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,73 @@
+#pragma once
+/*
+	Host stand-in for the RF24 library.
+
+	Packets written by the sketch are queued in Sim.h (radioSent) and
+	packets for the sketch to receive are injected with sim::radioInject()
+	or sim::scheduleRadio(). They are only received while the radio is
+	powered up and listening, and the RX FIFO holds 3 of them.
+	Whether a write is acknowledged is controlled by sim::radioAck.
+
+	The IRQ pin of the module is wired to D0 (sim::RADIO_IRQ_PIN), it goes
+	LOW while an unmasked status flag is set, like on the real chip.
+
+	With ACK payloads enabled, packets that come while the sketch is a
+	transmitter are held as the other console's ACK payload (only the newest)
+	and received with the acknowledgement of the next acked write. ACK payloads
+	loaded by the sketch are sent when the next packet is received.
+	startWrite() returns right away and sets TX_DS or MAX_RT later.
+*/
+#include <Arduino.h>
+
+typedef enum
+{
+	RF24_PA_MIN = 0,
+	RF24_PA_LOW,
+	RF24_PA_HIGH,
+	RF24_PA_MAX,
+	RF24_PA_ERROR
+} rf24_pa_dbm_e;
+
+class RF24
+{
+public:
+	RF24(uint16_t cePin, uint16_t csnPin);
+
+	bool begin(void);
+	bool isChipConnected(void);
+	void setPALevel(uint8_t level, bool lnaEnable = 1);
+	void setChannel(uint8_t channel);
+	void setRetries(uint8_t delay, uint8_t count);
+
+	void openWritingPipe(const uint8_t *address);
+	void openReadingPipe(uint8_t number, const uint8_t *address);
+
+	void powerDown(void);
+	void powerUp(void);
+	void startListening(void);
+	void stopListening(void);
+
+	bool available(void);
+	bool available(uint8_t *pipe_num);
+	void read(void *buf, uint8_t len);
+	bool write(const void *buf, uint8_t len);
+	void startWrite(const void *buf, uint8_t len, const bool multicast);
+
+	void setPayloadSize(uint8_t size);
+	uint8_t getPayloadSize(void);
+	void enableDynamicPayloads(void);
+	uint8_t getDynamicPayloadSize(void);
+	void enableAckPayload(void);
+	bool writeAckPayload(uint8_t pipe, const void *buf, uint8_t len);
+
+	void maskIRQ(bool tx_ok, bool tx_fail, bool rx_ready);
+	void whatHappened(bool &tx_ok, bool &tx_fail, bool &rx_ready);
+
+	uint8_t getARC(void);
+	uint8_t flush_rx(void);
+	uint8_t flush_tx(void);
+
+private:
+	uint8_t payloadSize;
+	bool listening, powered, dynamicPayloads;
+};
@@ -0,0 +1,6 @@
+#pragma once
+/*
+	The simulated display and radio account for their own bus traffic,
+	so the SPI class itself has nothing to do on the host.
+*/
+#include <Arduino.h>
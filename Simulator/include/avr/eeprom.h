@@ -0,0 +1,9 @@
+#pragma once
+/*
+	Host stand-in for avr/eeprom.h, backed by a 1 KB array in the simulator
+	(same size as the ATmega328 EEPROM).
+*/
+#include <stddef.h>
+
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_update_block(const void *src, void *dst, size_t n);
@@ -0,0 +1,20 @@
+#pragma once
+/*
+	Host stand-in for avr/interrupt.h.
+
+	Interrupt handlers defined with ISR() are plain functions that the
+	simulator calls between two hardware calls of the sketch, when the
+	interrupt is enabled and its time comes (see Sim.cpp). Handlers the
+	sketch doesn't define have empty weak defaults.
+*/
+#define ISR(vector) extern "C" void vector(void)
+
+#define TIMER0_COMPA_vect simVectorTimer0CompA
+#define PCINT2_vect simVectorPcint2
+#define ADC_vect simVectorAdc
+extern "C" void simVectorTimer0CompA(void);
+extern "C" void simVectorPcint2(void);
+extern "C" void simVectorAdc(void);
+
+void cli(void);
+void sei(void);
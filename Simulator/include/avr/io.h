@@ -0,0 +1,59 @@
+#pragma once
+/*
+	Host stand-in for avr/io.h, only the registers the sketch uses.
+
+	Input port registers (PINB, PINC, PIND) are read from the simulated pin
+	levels. Other registers are plain variables, the simulator looks at the
+	ones that enable interrupts (see avr/interrupt.h).
+*/
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+// port letter 'B', 'C' or 'D', bit n is the level of pin n of the port
+uint8_t simReadPort(char port);
+
+#define PINB (simReadPort('B'))
+#define PINC (simReadPort('C'))
+#define PIND (simReadPort('D'))
+
+// Timer0, runs millis() with prescaler 64, overflows every 1024 us
+extern volatile uint8_t TIMSK0;
+extern volatile uint8_t OCR0A;
+extern volatile uint8_t TCCR0A; // fast PWM set up by the core
+extern volatile uint8_t OCR0B;	// PWM of OC0B (D5, the vibrator)
+#define COM0B1 5
+#define TOIE0 0
+#define OCIE0A 1
+#define OCIE0B 2
+
+// Timer2, the buzzer on OC2B (D3) toggled by the timer in CTC mode
+extern volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2A, OCR2B;
+#define WGM21 1
+#define COM2B0 4
+
+// pin change interrupts, PCINT16-23 are D0-D7
+extern volatile uint8_t PCICR;
+extern volatile uint8_t PCMSK0, PCMSK1, PCMSK2;
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCINT16 0
+
+// USART0, the sketch only switches the receiver off (D0 is the radio IRQ)
+extern volatile uint8_t UCSR0B;
+#define TXEN0 3
+#define RXEN0 4
+
+// ADC, a conversion started with ADSC is done 13 ADC clocks later
+extern volatile uint8_t ADMUX;
+extern volatile uint8_t ADCSRA;
+extern volatile uint16_t ADC;
+#define REFS0 6
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE 3
+#define ADIF 4
+#define ADSC 6
+#define ADEN 7
@@ -0,0 +1,20 @@
+#pragma once
+/*
+	Host stand-in for avr/pgmspace.h. There is only one address space on
+	the host, so PROGMEM data is read with plain loads.
+*/
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr) (*(void *const *)(addr))
+
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define memcpy_P memcpy
@@ -0,0 +1,14 @@
+#pragma once
+/*
+	Host stand-in for avr/sleep.h. sleep_cpu() moves the virtual clock to
+	the next event that raises an interrupt (see Sim.cpp), the time is
+	counted in sim::cpuSleepNs.
+*/
+#include <stdint.h>
+
+#define SLEEP_MODE_IDLE 0
+
+void set_sleep_mode(uint8_t mode);
+void sleep_enable(void);
+void sleep_disable(void);
+void sleep_cpu(void);
@@ -0,0 +1,5 @@
+#pragma once
+/*
+	Host stand-in for new.h of the AVR core, placement new.
+*/
+#include <new>
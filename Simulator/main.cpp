@@ -0,0 +1,231 @@
+/*
+	Runs the sketch on the host against the stand-ins from Sim.h.
+
+	Usage: brick_sim [options]
+		--ms N          virtual milliseconds to run (default 10000)
+		--pong          scripted menu navigation into single player Pong
+		--script FILE   button script, one "<ms> <button> <down|up>" per line
+		--id N          console ID stored in the simulated EEPROM
+		--radio-ack     the simulated other console acknowledges every packet
+		--radio FILE    packets to receive, one "<ms> <hex bytes>" per line
+		--ppm FILE      save the last screen as a PPM image
+		--battery MV    battery voltage on A0 (default 3900)
+		--help, -h      print the usage
+
+	Results are printed as "key=value" lines so scripts can pick them up.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "Sim.h"
+
+void setup(void);
+void loop(void);
+
+static void usage(FILE *out, const char *name)
+{
+	fprintf(out, "usage: %s [--ms N] [--pong] [--script FILE] [--id N] [--radio-ack] [--radio FILE] [--ppm FILE] [--battery MV] [--help]\n", name);
+}
+
+static void press(const char *name, uint64_t atMs, uint64_t holdMs)
+{
+	int pin = sim::buttonPin(name);
+	if (pin < 0)
+	{
+		fprintf(stderr, "unknown button '%s'\n", name);
+		exit(2);
+	}
+
+	sim::scheduleButton(atMs, pin, true);
+	sim::scheduleButton(atMs + holdMs, pin, false);
+}
+
+/*
+	Main menu -> Play -> Pong -> Single easy, then keeps moving the
+	platform left and right so it gets redrawn too.
+*/
+static void scriptPong(uint64_t runMs)
+{
+	press("ok", 1000, 60);
+	press("ok", 1300, 60);
+	press("ok", 1600, 60);
+
+	for (uint64_t t = 2000; t < runMs; t += 800)
+	{
+		press("left", t, 300);
+		press("right", t + 400, 300);
+	}
+}
+
+static bool loadScript(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	if (!f)
+		return false;
+
+	char line[128];
+	while (fgets(line, sizeof(line), f))
+	{
+		unsigned long long ms;
+		char name[16], action[8];
+
+		if (line[0] == '#' || sscanf(line, "%llu %15s %7s", &ms, name, action) != 3)
+			continue;
+
+		int pin = sim::buttonPin(name);
+		if (pin < 0)
+		{
+			fprintf(stderr, "%s: unknown button '%s'\n", path, name);
+			fclose(f);
+			return false;
+		}
+		sim::scheduleButton(ms, pin, strcmp(action, "down") == 0);
+	}
+
+	fclose(f);
+	return true;
+}
+
+static bool loadRadioScript(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	if (!f)
+		return false;
+
+	char line[256];
+	while (fgets(line, sizeof(line), f))
+	{
+		unsigned long long ms;
+		int used;
+
+		if (line[0] == '#' || sscanf(line, "%llu%n", &ms, &used) != 1)
+			continue;
+
+		std::vector<uint8_t> packet;
+		unsigned value;
+		int n;
+		for (const char *p = line + used; sscanf(p, "%2x%n", &value, &n) == 1; p += n)
+			packet.push_back(value);
+
+		if (packet.empty() || packet.size() > 32)
+		{
+			fprintf(stderr, "%s: bad packet '%s'\n", path, line);
+			fclose(f);
+			return false;
+		}
+		sim::scheduleRadio(ms, packet);
+	}
+
+	fclose(f);
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t runMs = 10000;
+	bool pong = false;
+	const char *ppm = NULL;
+	const char *script = NULL;
+	const char *radioScript = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		const char *next = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strcmp(arg, "--ms") == 0 && next)
+			runMs = strtoull(argv[++i], NULL, 10);
+		else if (strcmp(arg, "--pong") == 0)
+			pong = true;
+		else if (strcmp(arg, "--script") == 0 && next)
+			script = argv[++i];
+		else if (strcmp(arg, "--id") == 0 && next)
+			sim::eeprom[2] = atoi(argv[++i]) != 0; // s_sett::id
+		else if (strcmp(arg, "--radio-ack") == 0)
+			sim::radioAck = true;
+		else if (strcmp(arg, "--radio") == 0 && next)
+			radioScript = argv[++i];
+		else if (strcmp(arg, "--ppm") == 0 && next)
+			ppm = argv[++i];
+		else if (strcmp(arg, "--battery") == 0 && next)
+			sim::setAnalog(14, atol(argv[++i]) * 1024 / 5000); // A0, 5 V reference
+		else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+		{
+			usage(stdout, argv[0]);
+			return 0;
+		}
+		else
+		{
+			usage(stderr, argv[0]);
+			return 2;
+		}
+	}
+
+	if (pong)
+		scriptPong(runMs);
+	if (script && !loadScript(script))
+	{
+		fprintf(stderr, "can't read script %s\n", script);
+		return 2;
+	}
+	if (radioScript && !loadRadioScript(radioScript))
+	{
+		fprintf(stderr, "can't read radio script %s\n", radioScript);
+		return 2;
+	}
+
+	sim::setDeadlineMs(runMs);
+	auto started = std::chrono::steady_clock::now();
+
+	try
+	{
+		setup();
+		while (1)
+			loop();
+	}
+	catch (sim::Halt &)
+	{
+	}
+
+	double hostMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+	sim::closeFrame();
+
+	const sim::DisplayStats &d = sim::displayStats;
+	const sim::FrameStats &f = sim::frameStats;
+	uint64_t frames = f.frames ? f.frames : 1;
+
+	printf("virtual_ms=%llu\n", (unsigned long long)(sim::nowNs() / 1000000));
+	printf("host_ms=%.1f\n", hostMs);
+	printf("frames=%llu\n", (unsigned long long)f.frames);
+	printf("frames_per_host_second=%.0f\n", f.frames / (hostMs / 1000.0));
+	printf("display_primitives=%llu\n", (unsigned long long)d.primitives);
+	printf("display_windows=%llu\n", (unsigned long long)d.windows);
+	printf("display_bytes=%llu\n", (unsigned long long)d.bytes);
+	printf("display_pixels=%llu\n", (unsigned long long)d.pixels);
+	printf("frame_bytes_avg=%.1f\n", (double)f.bytesTotal / frames);
+	printf("frame_bytes_max=%llu\n", (unsigned long long)f.bytesMax);
+	printf("frame_windows_avg=%.1f\n", (double)f.windowsTotal / frames);
+	printf("frame_primitives_avg=%.1f\n", (double)f.primitivesTotal / frames);
+	printf("frame_primitives_max=%llu\n", (unsigned long long)f.primitivesMax);
+	printf("frame_bus_us_avg=%.1f\n", f.busyNsTotal / 1000.0 / frames);
+	printf("frame_bus_us_max=%.1f\n", f.busyNsMax / 1000.0);
+	printf("radio_writes=%llu\n", (unsigned long long)sim::radioStats.writes);
+	printf("radio_acked=%llu\n", (unsigned long long)sim::radioStats.acked);
+	printf("radio_reads=%llu\n", (unsigned long long)sim::radioStats.reads);
+	printf("radio_lost=%llu\n", (unsigned long long)sim::radioStats.lost);
+	printf("radio_ack_payloads=%llu\n", (unsigned long long)sim::radioStats.ackPayloads);
+	printf("radio_spi_ops=%llu\n", (unsigned long long)sim::radioStats.spiOps);
+	printf("cpu_sleep_pct=%.1f\n", sim::cpuSleepNs * 100.0 / sim::nowNs());
+	printf("radio_powered_pct=%.1f\n", sim::radioPoweredNs() * 100.0 / sim::nowNs());
+	printf("buzzer_ms=%llu\n", (unsigned long long)(sim::buzzerNs / 1000000));
+	printf("vibrator_ms=%llu\n", (unsigned long long)(sim::vibratorNs / 1000000));
+
+	if (ppm && !sim::writePPM(ppm))
+	{
+		fprintf(stderr, "can't write %s\n", ppm);
+		return 1;
+	}
+
+	return 0;
+}